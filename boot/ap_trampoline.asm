@@ -0,0 +1,80 @@
+; AP Trampoline - Application processor startup code
+; NASM syntax, starts in 16-bit real mode
+
+; smp.c copies this blob to AP_TRAMPOLINE_BASE (below 1 MB, 4 KB aligned)
+; and sends the startup IPI with vector AP_TRAMPOLINE_BASE >> 12. Each AP
+; wakes up here at CS:IP = (base >> 4):0000, switches to protected mode
+; with a temporary flat GDT, loads the stack the BSP left in ap_boot_stack
+; and calls ap_boot_entry(ap_boot_cpu). Everything is addressed relative
+; to the copy, so the blob is position independent within low memory.
+
+AP_TRAMPOLINE_BASE  equ 0x8000      ; Must match smp.h
+
+%define REL(label) (AP_TRAMPOLINE_BASE + ((label) - ap_trampoline_start))
+
+section .text
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_boot_stack
+global ap_boot_entry
+global ap_boot_cpu
+
+bits 16
+ap_trampoline_start:
+    cli
+    cld
+
+    ; Flat real-mode data segment so REL() addresses are absolute
+    xor ax, ax
+    mov ds, ax
+
+    o32 lgdt [REL(ap_gdt_ptr)]
+
+    ; Enable protected mode; clear CD/NW, which INIT leaves set
+    mov eax, cr0
+    and eax, 0x9FFFFFFF
+    or eax, 1
+    mov cr0, eax
+
+    ; Far jump loads CS with the flat code segment (0x08)
+    jmp dword 0x08:REL(ap_protected)
+
+bits 32
+ap_protected:
+    ; Flat data segments (0x10)
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; Stack and entry point filled in by the BSP for this AP
+    mov esp, [REL(ap_boot_stack)]
+    push dword [REL(ap_boot_cpu)]
+    mov eax, [REL(ap_boot_entry)]
+    call eax
+
+    ; The entry point never returns
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+; Temporary GDT: null, flat code, flat data (same layout as gdt.c)
+align 8
+ap_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF
+    dq 0x00CF92000000FFFF
+ap_gdt_ptr:
+    dw ap_gdt_ptr - ap_gdt - 1
+    dd REL(ap_gdt)
+
+; Parameters written by smp.c into the low-memory copy
+align 4
+ap_boot_stack:  dd 0
+ap_boot_entry:  dd 0
+ap_boot_cpu:    dd 0
+
+ap_trampoline_end:
@@ -34,8 +34,10 @@ align 4
     dd DEPTH                        ; depth: 32 bits per pixel
 
 ; Stack section - 16KB aligned to 16 bytes
+; This is the bootstrap CPU's kernel stack; APs get theirs from smp.c
 section .bss
 align 16
+global stack_top
 stack_bottom:
     resb 16384                      ; 16 KB stack
 stack_top:
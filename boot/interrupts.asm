@@ -71,12 +71,11 @@ isr_common_stub:
     mov ax, ds
     push eax
 
-    ; Load kernel data segment
+    ; Load kernel data segment (GS keeps the per-CPU selector)
     mov ax, 0x10
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
 
     ; Push pointer to register structure as argument
     push esp
@@ -92,7 +91,6 @@ isr_common_stub:
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
 
     ; Restore all general purpose registers
     popa
@@ -134,6 +132,26 @@ IRQ 13, 45      ; FPU / Coprocessor
 IRQ 14, 46      ; Primary ATA Hard Disk
 IRQ 15, 47      ; Secondary ATA Hard Disk
 
+; Thread yield - a software interrupt, so voluntary switches save the
+; same registers_t frame as preemption (THREAD_YIELD_VECTOR in thread.h)
+global thread_yield_stub
+thread_yield_stub:
+    push dword 0        ; Dummy error code
+    push dword 48       ; Interrupt number
+    jmp irq_common_stub
+
+; Task pool wakeup IPI (TASKPOOL_WAKE_VECTOR) - only interrupts hlt
+global taskpool_wake_stub
+taskpool_wake_stub:
+    push dword 0        ; Dummy error code
+    push dword 0xF0     ; Interrupt number
+    jmp irq_common_stub
+
+; Local APIC spurious interrupt - needs no EOI and no handler
+global apic_spurious_stub
+apic_spurious_stub:
+    iret
+
 ; Common IRQ stub - saves registers and calls C handler
 irq_common_stub:
     ; Save all general purpose registers
@@ -143,12 +161,11 @@ irq_common_stub:
     mov ax, ds
     push eax
 
-    ; Load kernel data segment
+    ; Load kernel data segment (GS keeps the per-CPU selector)
     mov ax, 0x10
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
 
     ; Push pointer to register structure as argument
     push esp
@@ -156,15 +173,15 @@ irq_common_stub:
     ; Call C handler: irq_handler(registers_t *regs)
     call irq_handler
 
-    ; Clean up pushed argument
-    add esp, 4
+    ; Continue with the frame it returned - on a thread switch that is
+    ; the next thread's saved frame, on its own stack
+    mov esp, eax
 
     ; Restore data segment
     pop eax
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
 
     ; Restore all general purpose registers
     popa
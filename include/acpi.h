@@ -0,0 +1,42 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+/**
+ * ACPI table discovery
+ *
+ * Only what interrupt routing and CPU bring-up need: the MADT (APIC
+ * table) is parsed once at boot into g_madt.
+ */
+
+#define ACPI_MAX_CPUS    16
+#define ACPI_ISA_IRQS    16
+
+/* Interrupt source override flags (MPS INTI flags) */
+#define ACPI_POLARITY_MASK   0x03
+#define ACPI_POLARITY_LOW    0x03
+#define ACPI_TRIGGER_MASK    0x0C
+#define ACPI_TRIGGER_LEVEL   0x0C
+
+/* Interrupt topology from the MADT */
+typedef struct {
+    int valid;                              /* MADT found and parsed */
+    uint32_t lapic_addr;                    /* Local APIC MMIO base */
+    int cpu_count;                          /* Enabled processors */
+    uint8_t cpu_apic_ids[ACPI_MAX_CPUS];    /* Local APIC ID of each */
+    int ioapic_found;
+    uint8_t ioapic_id;                      /* First I/O APIC only */
+    uint32_t ioapic_addr;
+    uint32_t ioapic_gsi_base;
+    uint32_t isa_gsi[ACPI_ISA_IRQS];        /* ISA IRQ -> global system interrupt */
+    uint16_t isa_flags[ACPI_ISA_IRQS];      /* Polarity/trigger overrides */
+} acpi_madt_t;
+
+/* Global MADT info - defined in acpi.c */
+extern acpi_madt_t g_madt;
+
+/* Find the RSDP and parse the MADT. Returns 0 if a MADT was found */
+int acpi_init(void);
+
+#endif /* ACPI_H */
@@ -0,0 +1,76 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+
+/**
+ * Local APIC and I/O APIC
+ *
+ * When the MADT describes an I/O APIC, ISA interrupts are routed through
+ * it to the bootstrap CPU on the same vectors the 8259 PIC used (32-47),
+ * and the 8259s are masked. EOI is a single MMIO write.
+ */
+
+/* Local APIC registers (byte offsets from the MMIO base) */
+#define LAPIC_ID            0x020
+#define LAPIC_VERSION       0x030
+#define LAPIC_TPR           0x080   /* Task priority */
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0   /* Spurious interrupt vector */
+#define LAPIC_ESR           0x280   /* Error status */
+#define LAPIC_ICR_LOW       0x300   /* Interrupt command */
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_LVT_ERROR     0x370
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE  0x3E0
+
+/* Interrupt command register (low word) bits */
+#define LAPIC_ICR_INIT      0x00000500
+#define LAPIC_ICR_STARTUP   0x00000600
+#define LAPIC_ICR_PENDING   0x00001000  /* Delivery status */
+#define LAPIC_ICR_ASSERT    0x00004000
+#define LAPIC_ICR_ALL_BUT_SELF 0x000C0000  /* Destination shorthand */
+
+#define LAPIC_SVR_ENABLE    0x100
+#define LAPIC_LVT_MASKED    0x10000
+
+/* IA32_APIC_BASE MSR */
+#define MSR_APIC_BASE        0x1B
+#define MSR_APIC_BASE_ENABLE 0x800
+
+/* Spurious interrupts land here; they need no EOI */
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/* Vector of ISA IRQ 0 (matches the PIC remap) */
+#define APIC_IRQ_BASE_VECTOR 32
+
+/* Detect and enable the APICs. Returns 0 if interrupts now go through them */
+int apic_init(void);
+
+/* Enable the local APIC of an application processor */
+void apic_init_ap(void);
+
+/* Non-zero once apic_init() succeeded */
+int apic_is_enabled(void);
+
+/* Local APIC register access */
+uint32_t lapic_read(uint32_t reg);
+void lapic_write(uint32_t reg, uint32_t value);
+
+/* APIC ID of the calling CPU */
+uint8_t lapic_get_id(void);
+
+/* Send an inter-processor interrupt (ICR low word) and wait for delivery */
+void lapic_send_ipi(uint8_t apic_id, uint32_t icr_low);
+
+/* Signal end of interrupt to the local APIC */
+void apic_eoi(void);
+
+/* Mask or unmask an ISA IRQ (0-15) at the I/O APIC */
+void ioapic_set_masked(uint8_t irq, int masked);
+
+#endif /* APIC_H */
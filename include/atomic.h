@@ -0,0 +1,68 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+
+/**
+ * 32-bit atomic operations
+ *
+ * Thin wrappers over the compiler's __atomic builtins, which compile to
+ * lock-prefixed instructions on i686. Every operation is sequentially
+ * consistent unless its name says otherwise. 64-bit atomics would need
+ * cmpxchg8b and are deliberately left out.
+ */
+
+typedef struct {
+    volatile uint32_t value;
+} atomic_t;
+
+#define ATOMIC_INIT(v) { (v) }
+
+static inline uint32_t atomic_load(const atomic_t* a) {
+    return __atomic_load_n(&a->value, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_store(atomic_t* a, uint32_t v) {
+    __atomic_store_n(&a->value, v, __ATOMIC_SEQ_CST);
+}
+
+/* Add and return the new value */
+static inline uint32_t atomic_add(atomic_t* a, uint32_t v) {
+    return __atomic_add_fetch(&a->value, v, __ATOMIC_SEQ_CST);
+}
+
+/* Subtract and return the new value */
+static inline uint32_t atomic_sub(atomic_t* a, uint32_t v) {
+    return __atomic_sub_fetch(&a->value, v, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t atomic_inc(atomic_t* a) {
+    return atomic_add(a, 1);
+}
+
+static inline uint32_t atomic_dec(atomic_t* a) {
+    return atomic_sub(a, 1);
+}
+
+/* Store v and return the previous value */
+static inline uint32_t atomic_xchg(atomic_t* a, uint32_t v) {
+    return __atomic_exchange_n(&a->value, v, __ATOMIC_SEQ_CST);
+}
+
+/* Store desired if the value equals expected. Returns non-zero on success */
+static inline int atomic_cmpxchg(atomic_t* a, uint32_t expected, uint32_t desired) {
+    return __atomic_compare_exchange_n(&a->value, &expected, desired, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* Full memory barrier */
+static inline void atomic_fence(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/* Spin-wait hint for hyperthreads and virtual CPUs */
+static inline void cpu_relax(void) {
+    __asm__ volatile ("pause" : : : "memory");
+}
+
+#endif /* ATOMIC_H */
@@ -0,0 +1,50 @@
+#ifndef BGA_H
+#define BGA_H
+
+#include <stdint.h>
+
+/*
+ * Bochs Graphics Adapter (BGA / VBE DISPI interface)
+ * Emulated by Bochs and QEMU's std VGA; lets us change mode at runtime
+ * without going back to real mode for VBE calls.
+ */
+
+#define BGA_PORT_INDEX  0x01CE
+#define BGA_PORT_DATA   0x01CF
+
+/* Register indices */
+#define BGA_REG_ID           0x0
+#define BGA_REG_XRES         0x1
+#define BGA_REG_YRES         0x2
+#define BGA_REG_BPP          0x3
+#define BGA_REG_ENABLE       0x4
+#define BGA_REG_BANK         0x5
+#define BGA_REG_VIRT_WIDTH   0x6
+#define BGA_REG_VIRT_HEIGHT  0x7
+#define BGA_REG_X_OFFSET     0x8
+#define BGA_REG_Y_OFFSET     0x9
+#define BGA_REG_VIDEO_MEMORY 0xA    /* In 64KB units (ID 0xB0C2 and later) */
+
+/* Interface versions reported by BGA_REG_ID */
+#define BGA_ID_MIN  0xB0C0
+#define BGA_ID_MAX  0xB0C5
+
+/* BGA_REG_ENABLE bits */
+#define BGA_DISABLED     0x00
+#define BGA_ENABLED      0x01
+#define BGA_LFB_ENABLED  0x40
+#define BGA_NOCLEARMEM   0x80
+
+/* Largest mode the interface accepts */
+#define BGA_MAX_XRES 2560
+#define BGA_MAX_YRES 1600
+
+int bga_is_available(void);
+uint32_t bga_get_vram_size(void);   /* Bytes, 0 if unknown */
+int bga_set_mode(uint16_t width, uint16_t height, uint16_t bpp);
+
+/* Page flipping: a taller virtual screen, scrolled with the Y offset */
+int bga_set_virtual_height(uint16_t height);
+void bga_set_y_offset(uint16_t y);
+
+#endif
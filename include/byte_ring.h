@@ -0,0 +1,55 @@
+#ifndef BYTE_RING_H
+#define BYTE_RING_H
+
+#include <stdint.h>
+#include "atomic.h"
+
+/**
+ * Timestamped byte ring
+ *
+ * Lock-free single-producer / single-consumer queue between an interrupt
+ * top half (which reads a device port and pushes the raw byte) and the
+ * bottom half that decodes it. Each side writes only its own index, so
+ * the producer may interrupt the consumer at any point.
+ */
+
+#define BYTE_RING_SIZE 256      /* Power of two */
+
+typedef struct {
+    uint64_t tsc;               /* clock_cycles() when the byte arrived */
+    uint8_t data;
+} ring_byte_t;
+
+typedef struct {
+    atomic_t head;              /* Next slot to fill (producer) */
+    atomic_t tail;              /* Next slot to read (consumer) */
+    uint32_t dropped;           /* Bytes lost to a full ring */
+    ring_byte_t slots[BYTE_RING_SIZE];
+} byte_ring_t;
+
+/* Add a byte; returns 0 (and counts a drop) if the ring is full */
+static inline int byte_ring_push(byte_ring_t* ring, uint8_t data, uint64_t tsc) {
+    uint32_t head = atomic_load(&ring->head);
+    if (head - atomic_load(&ring->tail) >= BYTE_RING_SIZE) {
+        ring->dropped++;
+        return 0;
+    }
+    ring_byte_t* slot = &ring->slots[head & (BYTE_RING_SIZE - 1)];
+    slot->tsc = tsc;
+    slot->data = data;
+    atomic_store(&ring->head, head + 1);    /* Publishes the slot */
+    return 1;
+}
+
+/* Take the oldest byte; returns 0 if the ring is empty */
+static inline int byte_ring_pop(byte_ring_t* ring, ring_byte_t* out) {
+    uint32_t tail = atomic_load(&ring->tail);
+    if (tail == atomic_load(&ring->head)) {
+        return 0;
+    }
+    *out = ring->slots[tail & (BYTE_RING_SIZE - 1)];
+    atomic_store(&ring->tail, tail + 1);    /* Frees the slot */
+    return 1;
+}
+
+#endif /* BYTE_RING_H */
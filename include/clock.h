@@ -0,0 +1,43 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * High-resolution clock
+ *
+ * Reads the CPU time-stamp counter, calibrated against the PIT at boot.
+ * Reading it is a single rdtsc - no port I/O and no interrupts needed.
+ * CPUs without a TSC fall back to the timer tick.
+ */
+
+#define CLOCK_CALIBRATE_MS 50   /* Calibration window (PIT one-shot, max 54) */
+
+/* Calibrate the TSC (call once at boot, before clock_now_ns()) */
+void clock_init(void);
+
+/* TSC frequency in kHz, 0 if the CPU has no usable TSC */
+uint32_t clock_get_tsc_khz(void);
+
+/* Raw cycle counter (TSC), 0 without a TSC */
+uint64_t clock_cycles(void);
+
+/* Convert a cycle count to nanoseconds */
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+/* Nanoseconds since clock_init() */
+uint64_t clock_now_ns(void);
+
+/* Milliseconds since clock_init() */
+uint64_t clock_now_ms(void);
+
+/* TSC value ms milliseconds after clock_init() (for deadlines) */
+uint64_t clock_ms_to_tsc(uint64_t ms);
+
+/* Busy-wait at least us microseconds (safe with interrupts off) */
+void clock_delay_us(uint32_t us);
+
+/* 64-by-32-bit division (the kernel has no libgcc for plain 64-bit /) */
+uint64_t div64_32(uint64_t value, uint32_t divisor);
+
+#endif /* CLOCK_H */
@@ -0,0 +1,103 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+/**
+ * CPU feature detection via the CPUID instruction
+ */
+
+/* CPUID leaf 1 EDX feature bits */
+#define CPUID_EDX_TSC   (1 << 4)    /* Time Stamp Counter */
+#define CPUID_EDX_APIC  (1 << 9)    /* On-chip local APIC */
+#define CPUID_EDX_SSE   (1 << 25)   /* Streaming SIMD Extensions */
+#define CPUID_EDX_SSE2  (1 << 26)   /* SSE2 (movntdq, movnti) */
+
+/* CPUID leaf 1 ECX feature bits */
+#define CPUID_ECX_TSC_DEADLINE (1 << 24)   /* APIC timer TSC-deadline mode */
+
+/* CPU information filled in by cpu_init() */
+typedef struct {
+    char vendor[13];        /* "GenuineIntel", "AuthenticAMD", ... */
+    uint32_t max_leaf;      /* Highest standard CPUID leaf */
+    uint32_t features_edx;  /* CPUID leaf 1 EDX */
+    uint32_t features_ecx;  /* CPUID leaf 1 ECX */
+    int sse_enabled;        /* SSE state enabled in CR0/CR4 */
+} cpu_info_t;
+
+/* Global CPU info - defined in cpu.c */
+extern cpu_info_t g_cpu;
+
+/**
+ * Execute CPUID for the given leaf
+ */
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx,
+                         uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile ("cpuid"
+                      : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                      : "a"(leaf), "c"(0));
+}
+
+/**
+ * Read the Time Stamp Counter
+ */
+static inline uint64_t cpu_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * Disable interrupts and return the previous EFLAGS
+ * Pair with cpu_irq_restore() for short critical sections
+ */
+static inline uint32_t cpu_irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+/**
+ * Restore the interrupt flag saved by cpu_irq_save()
+ */
+static inline void cpu_irq_restore(uint32_t flags) {
+    if (flags & (1 << 9)) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+}
+
+/**
+ * Read a model-specific register
+ */
+static inline uint64_t cpu_rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * Write a model-specific register
+ */
+static inline void cpu_wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr"
+                      : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/**
+ * Detect CPU features and enable SSE if the CPU supports it
+ * Must be called before any code that uses SSE instructions
+ */
+void cpu_init(void);
+
+/**
+ * Enable SSE state on an application processor, matching the BSP
+ */
+void cpu_init_ap(void);
+
+/**
+ * Check a CPUID leaf 1 EDX feature bit
+ * @return Non-zero if the feature is present
+ */
+int cpu_has_feature_edx(uint32_t bit);
+
+#endif /* CPU_H */
@@ -0,0 +1,30 @@
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include <stdint.h>
+
+/* Mouse cursor dimensions */
+#define CURSOR_WIDTH  12
+#define CURSOR_HEIGHT 19
+
+/**
+ * Mouse cursor overlay
+ *
+ * The cursor is drawn straight onto the front buffer, never into the back
+ * buffer. The pixels under the sprite are saved and restored on every
+ * move, so moving the mouse only touches two small rectangles and never
+ * requires a scene repaint.
+ */
+
+/* Enable the overlay at the given position */
+void cursor_init(int x, int y);
+
+/* Move the cursor - safe to call from interrupt context */
+void cursor_move(int x, int y);
+
+/* Present hooks used by graphics_swap_buffers() */
+void cursor_present_begin(void);
+void cursor_present_rect(int x1, int y1, int x2, int y2);
+void cursor_present_end(void);
+
+#endif
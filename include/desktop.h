@@ -6,9 +6,17 @@
 /* Desktop background color (teal/cyan like Windows 95) */
 #define DESKTOP_BG_COLOR RGB(0, 128, 128)  /* #008080 */
 
+/* Default target frame rate - frames are only drawn when something changed */
+#define DESKTOP_FRAME_RATE 60
+
 /* Desktop functions */
 void desktop_init(void);
 void desktop_run(void);   /* Main GUI loop - never returns */
 void desktop_draw(void);
+int desktop_set_resolution(uint32_t width, uint32_t height);
+void desktop_lock(void);    /* Needed by other threads that touch the GUI */
+void desktop_unlock(void);
+void desktop_set_frame_rate(int fps);
+int desktop_get_frame_rate(void);
 
 #endif
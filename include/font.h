@@ -7,6 +7,9 @@
 #define FONT_WIDTH 8
 #define FONT_HEIGHT 16
 
+// Background color that leaves the pixels behind the glyph untouched
+#define FONT_TRANSPARENT 0xFF000000
+
 void font_draw_char(int x, int y, char c, color_t fg, color_t bg);
 void font_draw_string(int x, int y, const char* str, color_t fg, color_t bg);
 int font_get_width(void);
@@ -6,6 +6,14 @@
 /* Segment selector defines */
 #define KERNEL_CODE_SEG 0x08
 #define KERNEL_DATA_SEG 0x10
+#define KERNEL_TSS_SEG  0x18
+#define PERCPU_SEG      0x20    /* Loaded into GS; based at the CPU's percpu_t */
+
+/* Entries per CPU: null, code, data, TSS, per-CPU data */
+#define GDT_ENTRIES     5
+
+/* Each CPU gets its own GDT and TSS */
+#define GDT_MAX_CPUS    16
 
 /* GDT entry structure (8 bytes) */
 struct gdt_entry {
@@ -23,8 +31,28 @@ struct gdt_ptr {
     uint32_t base;          /* Base address of GDT */
 } __attribute__((packed));
 
-/* Function declarations */
-void gdt_init(void);
-void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity);
+/* 32-bit task state segment - only the ring 0 stack is used */
+struct tss_entry {
+    uint32_t prev_tss;
+    uint32_t esp0;          /* Stack loaded on a privilege change to ring 0 */
+    uint32_t ss0;
+    uint32_t esp1, ss1, esp2, ss2;
+    uint32_t cr3, eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed));
+
+/**
+ * Load a CPU's own GDT and TSS and point GS at its per-CPU data
+ * @param cpu Logical CPU index (0 is the bootstrap CPU)
+ * @param percpu_base Linear address of the CPU's per-CPU data
+ * @param percpu_size Size of the per-CPU data in bytes
+ * @param stack_top Top of the CPU's kernel stack (TSS esp0)
+ */
+void gdt_init_cpu(uint32_t cpu, uint32_t percpu_base, uint32_t percpu_size,
+                  uint32_t stack_top);
 
 #endif /* GDT_H */
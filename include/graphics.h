@@ -34,6 +34,14 @@ typedef struct {
 // Global graphics info - defined in graphics.c
 extern graphics_info_t g_graphics;
 
+// Off-screen pixel surface (same 32-bit format as the framebuffer)
+typedef struct {
+    uint32_t* pixels;
+    int width;
+    int height;
+    uint32_t pitch;      // bytes per row
+} surface_t;
+
 // Graphics initialization functions
 void graphics_init(void* multiboot_info);
 int graphics_is_available(void);
@@ -41,6 +49,34 @@ uint32_t graphics_get_width(void);
 uint32_t graphics_get_height(void);
 void graphics_swap_buffers(void);
 
+// Runtime resolution switching (Bochs/QEMU BGA only)
+int graphics_can_set_mode(void);
+int graphics_set_mode(uint32_t width, uint32_t height);
+
+// Presents since the back buffer was last current (1 = copy, 2 = page flip)
+int graphics_buffer_age(void);
+
+// Damage tracking - only marked areas are copied on the next swap
+void graphics_mark_dirty(int x, int y, int width, int height);
+
+// Direct front buffer access for overlays (no clipping, strides in pixels)
+void graphics_front_read(int x, int y, int width, int height,
+                         uint32_t* dst, int dst_stride);
+void graphics_front_write(int x, int y, int width, int height,
+                          const uint32_t* src, int src_stride);
+
+// Present row-copy kernels, chosen at boot from CPUID
+#define GRAPHICS_BLITTER_C      0   // Plain C loop
+#define GRAPHICS_BLITTER_MOVSD  1   // rep movsd
+#define GRAPHICS_BLITTER_SSE2   2   // SSE2 non-temporal stores
+#define GRAPHICS_BLITTER_COUNT  3
+
+int graphics_blitter_available(int blitter);
+const char* graphics_blitter_name(int blitter);
+int graphics_get_blitter(void);
+int graphics_set_blitter(int blitter);
+uint32_t graphics_benchmark_blitter(int blitter);  // Returns MB/s
+
 // Drawing functions
 void draw_pixel(int x, int y, color_t color);
 void draw_rect(int x, int y, int width, int height, color_t color);
@@ -49,5 +85,23 @@ void draw_line(int x1, int y1, int x2, int y2, color_t color);
 void draw_hline(int x, int y, int width, color_t color);
 void draw_vline(int x, int y, int height, color_t color);
 void clear_screen(color_t color);
+void draw_blit(int x, int y, const surface_t* src, int src_x, int src_y,
+               int width, int height);
+void draw_mask(int x, int y, const uint8_t* rows, int width, int height, color_t color);
+
+// Render target - drawing goes to the screen unless redirected to a surface
+// (origin_x, origin_y) is the screen position of the surface's top-left pixel
+void draw_set_target(const surface_t* surface, int origin_x, int origin_y);
+void draw_reset_target(void);
+
+// Clip rectangle (screen coordinates) - reset whenever the target changes
+void draw_set_clip(int x, int y, int width, int height);
+void draw_reset_clip(void);
+
+// Unclipped screen drawing without target, clip or damage state - safe to
+// call from several CPUs at once on disjoint rectangles (tile compositing)
+void draw_screen_fill(int x, int y, int width, int height, color_t color);
+void draw_screen_blit(int x, int y, const surface_t* src, int src_x, int src_y,
+                      int width, int height);
 
 #endif
@@ -0,0 +1,36 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Kernel heap - first-fit free list allocator
+ *
+ * The heap covers upper memory from the end of the kernel image to the
+ * top of RAM reported by the bootloader.
+ */
+
+/**
+ * Initialize the heap from multiboot memory info
+ * @param multiboot_info Pointer to multiboot info structure passed by GRUB
+ */
+void heap_init(void* multiboot_info);
+
+/**
+ * Allocate size bytes (16-byte aligned)
+ * @return Pointer to the block, or 0 if out of memory
+ */
+void* kmalloc(size_t size);
+
+/**
+ * Free a block returned by kmalloc (0 is ignored)
+ */
+void kfree(void* ptr);
+
+/**
+ * Get the number of free bytes in the heap
+ */
+size_t heap_free_bytes(void);
+
+#endif /* HEAP_H */
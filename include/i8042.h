@@ -0,0 +1,79 @@
+#ifndef I8042_H
+#define I8042_H
+
+#include <stdint.h>
+
+/**
+ * i8042 PS/2 controller
+ *
+ * i8042_init() runs the controller self-test and the interface test of
+ * both ports, with every wait bounded in time - a missing or dead
+ * controller costs milliseconds, not a hang. After that the controller
+ * is interrupt driven: the IRQ1/IRQ12 top halves queue raw bytes and a
+ * softirq routes them.
+ *
+ * Device commands are asynchronous. Each port has a queue; a command's
+ * bytes are sent one at a time, each waiting for the device's ACK
+ * (resent on request), then its reply bytes are collected and the
+ * completion callback runs in softirq context. A command that fails or
+ * times out aborts the rest of its port's queue, so a device that is not
+ * there costs one timeout and never blocks the caller. Bytes that arrive
+ * while a command waits but are not an ACK are stream data and go to the
+ * port's receiver.
+ */
+
+#define I8042_PORT_KEYBOARD 0
+#define I8042_PORT_AUX      1   /* Mouse */
+#define I8042_PORTS         2
+
+#define I8042_QUEUE_SIZE    16  /* Pending commands per port */
+#define I8042_MAX_CMD       2   /* Command byte plus one argument */
+#define I8042_MAX_REPLY     4
+#define I8042_MAX_RESENDS   3
+
+/* Time a controller command may take (self-test, config byte) */
+#define I8042_CTRL_TIMEOUT_US 20000
+
+/* Command completion status */
+#define I8042_OK            0
+#define I8042_TIMEOUT       -1
+#define I8042_ERROR         -2  /* Device refused the command */
+#define I8042_ABORTED       -3  /* An earlier command on the port failed */
+
+/* Stream data from a device (softirq context) */
+typedef void (*i8042_receive_t)(uint8_t data, uint64_t tsc);
+
+/* End of a batch of stream data - lets a driver coalesce (softirq context) */
+typedef void (*i8042_drained_t)(void);
+
+/* Command completion (softirq context) */
+typedef void (*i8042_done_t)(int port, int status, const uint8_t* reply, void* ctx);
+
+/**
+ * Initialize the controller (interrupts may still be off)
+ * Returns the number of working ports, 0 if there is no controller
+ */
+int i8042_init(void);
+
+/* Non-zero if a port passed its interface test */
+int i8042_port_present(int port);
+
+/* Set the handlers for a port's stream data (drained may be 0) */
+void i8042_set_receiver(int port, i8042_receive_t receive, i8042_drained_t drained);
+
+/**
+ * Queue a device command
+ * bytes: command and optional argument (each is ACKed separately)
+ * reply_len: bytes the device sends after the last ACK
+ * done may be 0. Returns 0 if queued, -1 if the port is absent or full.
+ */
+int i8042_command(int port, const uint8_t* bytes, int len, int reply_len,
+                  uint32_t timeout_ms, i8042_done_t done, void* ctx);
+
+/* Single-byte convenience forms */
+int i8042_command1(int port, uint8_t command, uint32_t timeout_ms,
+                   i8042_done_t done, void* ctx);
+int i8042_command2(int port, uint8_t command, uint8_t arg, uint32_t timeout_ms,
+                   i8042_done_t done, void* ctx);
+
+#endif /* I8042_H */
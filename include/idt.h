@@ -51,6 +51,11 @@ typedef struct idt_ptr idt_ptr_t;
  */
 void idt_init(void);
 
+/**
+ * Load the (already initialized) IDT on the calling CPU
+ */
+void idt_load(void);
+
 /**
  * Set an IDT gate entry
  * @param num The interrupt number (0-255)
@@ -77,8 +82,9 @@ void isr_handler(registers_t *regs);
 /**
  * IRQ handler (called from assembly stub)
  * @param regs Pointer to saved register state
+ * @return Register state to resume (another thread's on a context switch)
  */
-void irq_handler(registers_t *regs);
+registers_t* irq_handler(registers_t *regs);
 
 /* ISR (Interrupt Service Routine) declarations - CPU exceptions 0-31 */
 extern void isr0(void);     /* Division By Zero */
@@ -133,6 +139,9 @@ extern void irq13(void);    /* FPU / Coprocessor / Inter-processor */
 extern void irq14(void);    /* Primary ATA Hard Disk */
 extern void irq15(void);    /* Secondary ATA Hard Disk */
 
+/* Local APIC spurious interrupt vector stub (just returns) */
+extern void apic_spurious_stub(void);
+
 /* IRQ numbers (remapped to avoid CPU exception conflicts) */
 #define IRQ0    32
 #define IRQ1    33
@@ -0,0 +1,63 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+/**
+ * Input event queue
+ *
+ * Keyboard and mouse bottom halves turn device bytes into typed events
+ * and append them to one lock-free single-producer / single-consumer
+ * queue. The producer side is the softirq context (bottom halves never
+ * nest, and input IRQs are delivered to the BSP only); the consumer is
+ * whichever loop owns input - the desktop, or the text-mode shell
+ * through keyboard_getchar(). Each event carries the TSC value of the
+ * interrupt that delivered its last byte; autorepeated keys carry the
+ * time the repeat was generated.
+ */
+
+#define INPUT_QUEUE_SIZE 256    /* Events, power of two */
+
+/* Event types */
+#define INPUT_KEY_DOWN     1
+#define INPUT_KEY_UP       2
+#define INPUT_MOUSE_MOVE   3
+#define INPUT_MOUSE_BUTTON 4
+#define INPUT_MOUSE_WHEEL  5
+
+/* Modifier state bits (held keys, and Caps Lock while on) */
+#define INPUT_MOD_SHIFT 0x01
+#define INPUT_MOD_CTRL  0x02
+#define INPUT_MOD_ALT   0x04
+#define INPUT_MOD_CAPS  0x08
+
+/* Extended (0xE0-prefixed) scancodes are reported as 0xE000 | code */
+#define INPUT_SCANCODE_EXTENDED 0xE000
+
+typedef struct {
+    uint64_t tsc;           /* clock_cycles() at the interrupt */
+    uint8_t type;           /* INPUT_* */
+    uint8_t modifiers;      /* INPUT_MOD_* when the event happened */
+    uint8_t buttons;        /* Mouse buttons held after the event */
+    uint8_t changed;        /* Mouse buttons that changed (button events) */
+    uint16_t scancode;      /* Key events: set 1 code without the release bit */
+    uint16_t key;           /* Key events: character or KEY_* code, 0 if none */
+    uint8_t keycode;        /* Key events: KEYCODE_* (keyboard.h) */
+    uint8_t repeat;         /* Key down events: generated by autorepeat */
+    int32_t x, y;           /* Mouse events: pointer position after the event */
+    int32_t wheel;          /* Wheel events: detents, positive = towards the user */
+} input_event_t;
+
+/* Append an event (bottom halves only); returns 0 if the queue is full */
+int input_push(const input_event_t* event);
+
+/* Take the oldest event (consumer only); returns 0 if there is none */
+int input_pop(input_event_t* event);
+
+/* Non-zero if events are waiting */
+int input_pending(void);
+
+/* Events lost to a full queue */
+uint32_t input_dropped(void);
+
+#endif /* INPUT_H */
@@ -0,0 +1,71 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+
+/**
+ * Interrupt controller front end
+ *
+ * Drivers enable their IRQ lines and the IRQ dispatcher acknowledges
+ * interrupts through these calls, whichever controller is in charge:
+ * the local/I/O APIC when present, the 8259 PIC otherwise.
+ */
+
+/* Set up the PIC, then switch to the APIC if the machine has one */
+void irq_init(void);
+
+/* Enable / disable an ISA IRQ line (0-15) */
+void irq_unmask(uint8_t irq);
+void irq_mask(uint8_t irq);
+
+/* Acknowledge an interrupt (end of interrupt) */
+void irq_eoi(uint8_t irq);
+
+/* "apic" or "pic" */
+const char* irq_controller_name(void);
+
+/**
+ * Handler registry
+ *
+ * Drivers register a handler per ISA IRQ; several handlers may share a
+ * line and are called in registration order. A handler returns
+ * IRQ_HANDLED if its device raised the interrupt, IRQ_NONE otherwise.
+ */
+
+#define IRQ_LINES        16
+#define IRQ_MAX_HANDLERS 32     /* Across all lines */
+
+#define IRQ_NONE    0
+#define IRQ_HANDLED 1
+
+typedef int (*irq_handler_t)(void* ctx);
+
+/* Add a handler to an IRQ line. Returns 0 on success, -1 if full */
+int irq_register(uint8_t irq, irq_handler_t handler, void* ctx);
+
+/**
+ * Run the handlers of an IRQ (called by the dispatcher in idt.c)
+ * Returns 0 for a spurious PIC interrupt (IRQ7/IRQ15 with its in-service
+ * bit clear), which must not be acknowledged; any EOI it still needs has
+ * been sent. Returns 1 otherwise - the caller sends the EOI.
+ */
+int irq_dispatch(uint8_t irq);
+
+/* Handler time histogram: bucket i counts runs under 2^i us, the last */
+/* bucket everything longer */
+#define IRQ_HIST_BUCKETS 8
+
+typedef struct {
+    uint32_t count;             /* Interrupts dispatched */
+    uint32_t spurious;          /* Spurious IRQ7/IRQ15 from the PIC */
+    uint32_t unhandled;         /* No handler claimed it */
+    uint32_t handlers;          /* Handlers registered */
+    uint64_t total_cycles;      /* Time in handlers (TSC) */
+    uint64_t max_cycles;
+    uint32_t hist[IRQ_HIST_BUCKETS];
+} irq_stats_t;
+
+/* Snapshot of one line's statistics; returns 0 if irq is out of range */
+int irq_get_stats(uint8_t irq, irq_stats_t* out);
+
+#endif /* IRQ_H */
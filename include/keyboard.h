@@ -3,38 +3,181 @@
 
 #include <stdint.h>
 
-/* Keyboard I/O ports */
-#define KEYBOARD_DATA_PORT   0x60
-#define KEYBOARD_STATUS_PORT 0x64
-
-/* Keyboard buffer size */
-#define KEYBOARD_BUFFER_SIZE 256
-
 /* Special key codes */
 #define KEY_BACKSPACE 0x08
 #define KEY_ENTER     0x0A
 #define KEY_TAB       0x09
 #define KEY_ESCAPE    0x1B
 
+/* Ctrl held with a letter gives its control character (Ctrl-C = 0x03) */
+#define KEY_CTRL(c)   ((c) & 0x1F)
+
 /* Arrow key codes (use values > 127 to avoid ASCII conflict) */
 #define KEY_UP        0x80
 #define KEY_DOWN      0x81
 #define KEY_LEFT      0x82
 #define KEY_RIGHT     0x83
 
+/* Navigation and function keys */
+#define KEY_HOME      0x84
+#define KEY_END       0x85
+#define KEY_PAGE_UP   0x86
+#define KEY_PAGE_DOWN 0x87
+#define KEY_INSERT    0x88
+#define KEY_DELETE    0x89
+#define KEY_F1        0x8A      /* KEY_F1 + n - 1 for F1..F12 */
+#define KEY_F12       0x95
+
+/* Software autorepeat of a held key */
+#define KEYBOARD_REPEAT_DELAY_MS    500
+#define KEYBOARD_REPEAT_INTERVAL_MS 33     /* About 30 characters per second */
+
+/**
+ * Keycodes
+ *
+ * A keycode names a physical key: the set 1 make code, with
+ * KEYCODE_EXTENDED added for 0xE0-prefixed keys, so every key fits in a
+ * byte. The list below is the only description of the layout (US
+ * QWERTY); the keycode names and the driver's translation tables are all
+ * generated from it at compile time.
+ *
+ * ENTRY(name, keycode, key, shifted key)
+ */
+#define KEYCODE_EXTENDED 0x80
+#define KEYCODE_COUNT    256
+
+#define KEYBOARD_KEYS(ENTRY) \
+    ENTRY(ESCAPE,       0x01, KEY_ESCAPE,    KEY_ESCAPE)    \
+    ENTRY(1,            0x02, '1',           '!')           \
+    ENTRY(2,            0x03, '2',           '@')           \
+    ENTRY(3,            0x04, '3',           '#')           \
+    ENTRY(4,            0x05, '4',           '$')           \
+    ENTRY(5,            0x06, '5',           '%')           \
+    ENTRY(6,            0x07, '6',           '^')           \
+    ENTRY(7,            0x08, '7',           '&')           \
+    ENTRY(8,            0x09, '8',           '*')           \
+    ENTRY(9,            0x0A, '9',           '(')           \
+    ENTRY(0,            0x0B, '0',           ')')           \
+    ENTRY(MINUS,        0x0C, '-',           '_')           \
+    ENTRY(EQUALS,       0x0D, '=',           '+')           \
+    ENTRY(BACKSPACE,    0x0E, KEY_BACKSPACE, KEY_BACKSPACE) \
+    ENTRY(TAB,          0x0F, KEY_TAB,       KEY_TAB)       \
+    ENTRY(Q,            0x10, 'q',           'Q')           \
+    ENTRY(W,            0x11, 'w',           'W')           \
+    ENTRY(E,            0x12, 'e',           'E')           \
+    ENTRY(R,            0x13, 'r',           'R')           \
+    ENTRY(T,            0x14, 't',           'T')           \
+    ENTRY(Y,            0x15, 'y',           'Y')           \
+    ENTRY(U,            0x16, 'u',           'U')           \
+    ENTRY(I,            0x17, 'i',           'I')           \
+    ENTRY(O,            0x18, 'o',           'O')           \
+    ENTRY(P,            0x19, 'p',           'P')           \
+    ENTRY(LEFT_BRACKET, 0x1A, '[',           '{')           \
+    ENTRY(RIGHT_BRACKET,0x1B, ']',           '}')           \
+    ENTRY(ENTER,        0x1C, KEY_ENTER,     KEY_ENTER)     \
+    ENTRY(LEFT_CTRL,    0x1D, 0,             0)             \
+    ENTRY(A,            0x1E, 'a',           'A')           \
+    ENTRY(S,            0x1F, 's',           'S')           \
+    ENTRY(D,            0x20, 'd',           'D')           \
+    ENTRY(F,            0x21, 'f',           'F')           \
+    ENTRY(G,            0x22, 'g',           'G')           \
+    ENTRY(H,            0x23, 'h',           'H')           \
+    ENTRY(J,            0x24, 'j',           'J')           \
+    ENTRY(K,            0x25, 'k',           'K')           \
+    ENTRY(L,            0x26, 'l',           'L')           \
+    ENTRY(SEMICOLON,    0x27, ';',           ':')           \
+    ENTRY(QUOTE,        0x28, '\'',          '"')           \
+    ENTRY(GRAVE,        0x29, '`',           '~')           \
+    ENTRY(LEFT_SHIFT,   0x2A, 0,             0)             \
+    ENTRY(BACKSLASH,    0x2B, '\\',          '|')           \
+    ENTRY(Z,            0x2C, 'z',           'Z')           \
+    ENTRY(X,            0x2D, 'x',           'X')           \
+    ENTRY(C,            0x2E, 'c',           'C')           \
+    ENTRY(V,            0x2F, 'v',           'V')           \
+    ENTRY(B,            0x30, 'b',           'B')           \
+    ENTRY(N,            0x31, 'n',           'N')           \
+    ENTRY(M,            0x32, 'm',           'M')           \
+    ENTRY(COMMA,        0x33, ',',           '<')           \
+    ENTRY(PERIOD,       0x34, '.',           '>')           \
+    ENTRY(SLASH,        0x35, '/',           '?')           \
+    ENTRY(RIGHT_SHIFT,  0x36, 0,             0)             \
+    ENTRY(KP_MULTIPLY,  0x37, '*',           '*')           \
+    ENTRY(LEFT_ALT,     0x38, 0,             0)             \
+    ENTRY(SPACE,        0x39, ' ',           ' ')           \
+    ENTRY(CAPS_LOCK,    0x3A, 0,             0)             \
+    ENTRY(F1,           0x3B, KEY_F1,        KEY_F1)        \
+    ENTRY(F2,           0x3C, KEY_F1 + 1,    KEY_F1 + 1)    \
+    ENTRY(F3,           0x3D, KEY_F1 + 2,    KEY_F1 + 2)    \
+    ENTRY(F4,           0x3E, KEY_F1 + 3,    KEY_F1 + 3)    \
+    ENTRY(F5,           0x3F, KEY_F1 + 4,    KEY_F1 + 4)    \
+    ENTRY(F6,           0x40, KEY_F1 + 5,    KEY_F1 + 5)    \
+    ENTRY(F7,           0x41, KEY_F1 + 6,    KEY_F1 + 6)    \
+    ENTRY(F8,           0x42, KEY_F1 + 7,    KEY_F1 + 7)    \
+    ENTRY(F9,           0x43, KEY_F1 + 8,    KEY_F1 + 8)    \
+    ENTRY(F10,          0x44, KEY_F1 + 9,    KEY_F1 + 9)    \
+    ENTRY(NUM_LOCK,     0x45, 0,             0)             \
+    ENTRY(SCROLL_LOCK,  0x46, 0,             0)             \
+    ENTRY(KP_7,         0x47, '7',           '7')           \
+    ENTRY(KP_8,         0x48, '8',           '8')           \
+    ENTRY(KP_9,         0x49, '9',           '9')           \
+    ENTRY(KP_MINUS,     0x4A, '-',           '-')           \
+    ENTRY(KP_4,         0x4B, '4',           '4')           \
+    ENTRY(KP_5,         0x4C, '5',           '5')           \
+    ENTRY(KP_6,         0x4D, '6',           '6')           \
+    ENTRY(KP_PLUS,      0x4E, '+',           '+')           \
+    ENTRY(KP_1,         0x4F, '1',           '1')           \
+    ENTRY(KP_2,         0x50, '2',           '2')           \
+    ENTRY(KP_3,         0x51, '3',           '3')           \
+    ENTRY(KP_0,         0x52, '0',           '0')           \
+    ENTRY(KP_PERIOD,    0x53, '.',           '.')           \
+    ENTRY(F11,          0x57, KEY_F1 + 10,   KEY_F1 + 10)   \
+    ENTRY(F12,          0x58, KEY_F12,       KEY_F12)       \
+    ENTRY(KP_ENTER,     0x9C, KEY_ENTER,     KEY_ENTER)     \
+    ENTRY(RIGHT_CTRL,   0x9D, 0,             0)             \
+    ENTRY(KP_DIVIDE,    0xB5, '/',           '/')           \
+    ENTRY(RIGHT_ALT,    0xB8, 0,             0)             \
+    ENTRY(HOME,         0xC7, KEY_HOME,      KEY_HOME)      \
+    ENTRY(UP,           0xC8, KEY_UP,        KEY_UP)        \
+    ENTRY(PAGE_UP,      0xC9, KEY_PAGE_UP,   KEY_PAGE_UP)   \
+    ENTRY(LEFT,         0xCB, KEY_LEFT,      KEY_LEFT)      \
+    ENTRY(RIGHT,        0xCD, KEY_RIGHT,     KEY_RIGHT)     \
+    ENTRY(END,          0xCF, KEY_END,       KEY_END)       \
+    ENTRY(DOWN,         0xD0, KEY_DOWN,      KEY_DOWN)      \
+    ENTRY(PAGE_DOWN,    0xD1, KEY_PAGE_DOWN, KEY_PAGE_DOWN) \
+    ENTRY(INSERT,       0xD2, KEY_INSERT,    KEY_INSERT)    \
+    ENTRY(DELETE,       0xD3, KEY_DELETE,    KEY_DELETE)    \
+    ENTRY(LEFT_GUI,     0xDB, 0,             0)             \
+    ENTRY(RIGHT_GUI,    0xDC, 0,             0)             \
+    ENTRY(MENU,         0xDD, 0,             0)
+
+#define KEYBOARD_KEYCODE_ENUM(name, code, key, shifted) KEYCODE_##name = code,
+enum {
+    KEYBOARD_KEYS(KEYBOARD_KEYCODE_ENUM)
+};
+#undef KEYBOARD_KEYCODE_ENUM
+
 /* Function declarations */
 
 /**
  * Initialize the keyboard driver
- * Must be called after IDT and PIC are set up
+ * Must be called after i8042_init()
  */
 void keyboard_init(void);
 
 /**
- * Keyboard interrupt handler (IRQ1 / Interrupt 33)
- * Called from the interrupt handler in idt.c
+ * Get the held modifiers (INPUT_MOD_* from input.h)
+ */
+uint8_t keyboard_get_modifiers(void);
+
+/**
+ * Check whether a key is held down (KEYCODE_*)
+ */
+int keyboard_key_down(uint8_t keycode);
+
+/*
+ * The calls below consume the input event queue (see input.h) - they are
+ * for the text-mode shell; the desktop reads events directly.
  */
-void keyboard_handler(void);
 
 /**
  * Read one character from keyboard (blocking)
@@ -43,14 +186,14 @@ void keyboard_handler(void);
 char keyboard_getchar(void);
 
 /**
- * Check if there are characters available in the buffer
- * Returns 1 if buffer has data, 0 otherwise
+ * Check if input events are waiting
+ * Returns 1 if the queue has events (not necessarily characters), 0 otherwise
  */
 int keyboard_has_data(void);
 
 /**
- * Get character from buffer without blocking
- * Returns the character or 0 if buffer is empty
+ * Get character without blocking
+ * Returns the character or 0 if no key press is waiting
  */
 char keyboard_getchar_nonblocking(void);
 
@@ -0,0 +1,60 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/**
+ * Input-to-photon latency
+ *
+ * Every input event carries the TSC of the interrupt that delivered it.
+ * The desktop notes when it takes the event off the queue and when its
+ * handler returns; if the event left something to redraw, it then waits
+ * for the next frame, which stamps composition and presentation. Each
+ * stage goes into its own histogram, and the total runs from the
+ * interrupt to the end of graphics_swap_buffers(). Compose and present
+ * are counted once per frame that showed input, the other stages once
+ * per event.
+ *
+ * All calls except latency_get_stats() and latency_reset() come from the
+ * desktop thread with the desktop lock held; those two need it as well.
+ */
+
+enum {
+    LATENCY_QUEUE,      /* Interrupt -> desktop takes the event */
+    LATENCY_HANDLE,     /* Event handler */
+    LATENCY_WAIT,       /* Handled -> frame starts (frame pacing) */
+    LATENCY_COMPOSE,    /* Frame start -> scene composited */
+    LATENCY_PRESENT,    /* Copy to the screen */
+    LATENCY_TOTAL,      /* Interrupt -> on screen */
+    LATENCY_STAGES
+};
+
+/* Events that can wait for one frame; more are not measured */
+#define LATENCY_MAX_PENDING 32
+
+/* Histogram: bucket i counts times under 16 << i us, the last bucket */
+/* everything longer (32 ms and up) */
+#define LATENCY_HIST_BUCKETS 13
+#define LATENCY_HIST_BASE_US 16
+
+typedef struct {
+    uint32_t count;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+    uint32_t hist[LATENCY_HIST_BUCKETS];
+} latency_stats_t;
+
+/* An event's handler returned and its effect waits for the next frame */
+void latency_input_handled(uint64_t irq_tsc, uint64_t dequeue_tsc);
+
+/* A frame reached the screen; accounts every event waiting for it */
+void latency_frame(uint64_t start_tsc, uint64_t composed_tsc, uint64_t presented_tsc);
+
+/* Snapshot of one stage, and its short name */
+void latency_get_stats(int stage, latency_stats_t* out);
+const char* latency_stage_name(int stage);
+
+/* Forget everything measured so far */
+void latency_reset(void);
+
+#endif /* LATENCY_H */
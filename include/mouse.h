@@ -10,13 +10,31 @@ typedef struct {
     uint8_t buttons;  // bit 0 = left, bit 1 = right, bit 2 = middle
 } mouse_state_t;
 
+// Device settings
+typedef struct {
+    int present;        // Device answered its setup sequence
+    int sample_rate;    // Reports per second
+    int resolution;     // Counts per millimetre
+    int has_wheel;      // IntelliMouse (4-byte packets with wheel)
+    int packet_size;
+} mouse_config_t;
+
+// Sample rate (10, 20, 40, 60, 80, 100 or 200 Hz) and resolution
+// (1, 2, 4 or 8 counts/mm) programmed by mouse_init()
+#define MOUSE_DEFAULT_RATE       200
+#define MOUSE_DEFAULT_RESOLUTION 4
+
+#define MOUSE_MAX_PACKET 4
+
 // Button masks
 #define MOUSE_LEFT_BUTTON   0x01
 #define MOUSE_RIGHT_BUTTON  0x02
 #define MOUSE_MIDDLE_BUTTON 0x04
 
 void mouse_init(void);
-void mouse_handler(void);
+void mouse_set_bounds(int width, int height);
+int mouse_configure(int hz, int counts_per_mm);   // 0 keeps a setting
+void mouse_get_config(mouse_config_t* config);
 mouse_state_t mouse_get_state(void);
 int mouse_get_x(void);
 int mouse_get_y(void);
@@ -44,6 +44,11 @@
  */
 void pic_init(void);
 
+/**
+ * Mask all IRQs on both PICs (when the APIC takes over)
+ */
+void pic_disable(void);
+
 /**
  * Send End of Interrupt (EOI) signal to PIC(s)
  * Must be called at the end of IRQ handlers
@@ -0,0 +1,53 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdint.h>
+
+/**
+ * Rectangle region algebra
+ *
+ * A region is a list of non-overlapping rectangles. Operations that would
+ * overflow the fixed rectangle budget fall back to a conservative result
+ * (a region that covers at least the exact answer), which is always safe
+ * for damage and visibility clipping. Occluders need the opposite - an
+ * inflated occluder hides pixels that are really exposed - and are built
+ * with region_union_rect_inner(), which drops the rect instead.
+ */
+
+/* Half-open rectangle: [x1, x2) x [y1, y2) */
+typedef struct {
+    int x1, y1;
+    int x2, y2;
+} rect_t;
+
+#define REGION_MAX_RECTS 64
+
+typedef struct {
+    int count;
+    rect_t rects[REGION_MAX_RECTS];
+} region_t;
+
+/* Build a rect from position and size */
+rect_t rect_make(int x, int y, int width, int height);
+
+/* Rectangle helpers */
+int rect_is_empty(const rect_t* r);
+int rect_intersect(const rect_t* a, const rect_t* b, rect_t* out);
+
+/* Region construction */
+void region_clear(region_t* region);
+void region_set_rect(region_t* region, const rect_t* rect);
+void region_copy(region_t* dst, const region_t* src);
+int region_is_empty(const region_t* region);
+rect_t region_bounds(const region_t* region);
+
+/* Region algebra (results are stored in the first argument) */
+void region_union_rect(region_t* region, const rect_t* rect);
+void region_union_rect_inner(region_t* region, const rect_t* rect);
+void region_union(region_t* region, const region_t* other);
+void region_subtract_rect(region_t* region, const rect_t* rect);
+void region_subtract(region_t* region, const region_t* other);
+void region_intersect_rect(region_t* region, const rect_t* rect);
+void region_intersect(region_t* region, const region_t* other);
+
+#endif /* REGION_H */
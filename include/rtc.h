@@ -13,9 +13,12 @@ typedef struct {
     uint8_t year;
 } rtc_time_t;
 
-/* Initialize RTC */
+/* Initialize RTC (enables IRQ8) */
 void rtc_init(void);
 
+/* Seconds the clock has ticked over since rtc_init() */
+uint32_t rtc_get_update_count(void);
+
 /* Get current time */
 void rtc_get_time(rtc_time_t* time);
 
@@ -0,0 +1,77 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+/**
+ * Symmetric multiprocessing
+ *
+ * The bootstrap CPU (BSP) wakes every other processor listed in the MADT
+ * with INIT-SIPI-SIPI. Each application processor (AP) runs a real-mode
+ * trampoline copied to low memory, then loads its own GDT, TSS and
+ * kernel stack and enables its local APIC. Device interrupts still go
+ * to the BSP only; APs halt until they are given work.
+ *
+ * Every CPU's GS segment is based at its percpu_t, so this_cpu() is a
+ * single load with no lookup.
+ */
+
+#define SMP_MAX_CPUS        16
+#define SMP_AP_STACK_SIZE   16384
+
+/* Physical address the AP trampoline is copied to (must match the asm) */
+#define AP_TRAMPOLINE_BASE  0x8000
+
+struct thread;
+
+/* Per-CPU data */
+typedef struct percpu {
+    struct percpu* self;        /* Linear address of this struct (GS:0) */
+    uint32_t index;             /* Logical CPU number, 0 = BSP */
+    uint8_t apic_id;            /* Local APIC ID */
+    volatile int online;        /* Set by the CPU itself once running */
+    uint32_t stack_top;         /* Top of the kernel stack */
+    struct thread* current;     /* Running thread (see thread.c) */
+    uint32_t tasks_run;         /* Task pool tasks executed */
+    uint32_t softirq_pending;   /* Raised softirqs (see softirq.c) */
+    int in_softirq;             /* Running softirqs - nested IRQs leave them */
+} percpu_t;
+
+/**
+ * Get the calling CPU's per-CPU data
+ */
+static inline percpu_t* this_cpu(void) {
+    percpu_t* cpu;
+    __asm__ volatile ("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+/**
+ * Set up the bootstrap CPU's GDT, TSS and per-CPU data
+ * Call once, early, before anything uses this_cpu()
+ */
+void smp_init_bsp(void);
+
+/**
+ * Start all application processors listed in the MADT
+ * Needs the local APIC and a calibrated clock.
+ * @return Number of CPUs online, including the BSP
+ */
+int smp_init(void);
+
+/**
+ * Number of CPUs running (including the BSP)
+ */
+int smp_cpu_count(void);
+
+/**
+ * Number of CPUs known, online or not (MADT entries, capped at SMP_MAX_CPUS)
+ */
+int smp_cpu_present(void);
+
+/**
+ * Get a CPU's per-CPU data by logical index (0 .. smp_cpu_present() - 1)
+ */
+percpu_t* smp_get_cpu(int index);
+
+#endif /* SMP_H */
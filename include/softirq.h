@@ -0,0 +1,47 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+
+/**
+ * Deferred interrupt work (bottom halves)
+ *
+ * An interrupt handler does the minimum with interrupts off - typically
+ * reading a device port into a byte_ring_t - and raises its softirq.
+ * Raised softirqs run on the same CPU right after the EOI, with
+ * interrupts enabled, before the interrupt returns or the scheduler
+ * switches threads. Interrupts that arrive meanwhile only queue more
+ * work; the softirq loop picks it up before it finishes.
+ *
+ * Code that masks interrupts (cpu_irq_save) also keeps softirqs out.
+ */
+
+enum {
+    SOFTIRQ_PS2,        /* Keyboard and mouse bytes (i8042.c) */
+    SOFTIRQ_KEYBOARD,   /* Key autorepeat (keyboard.c) */
+    SOFTIRQ_COUNT
+};
+
+/* Passes over the pending set before leaving the rest for the next IRQ */
+/* (a timer interrupt is requested 1 ms out so the rest is not stranded) */
+#define SOFTIRQ_MAX_RESTART 8
+
+typedef void (*softirq_fn_t)(void);
+
+/* Install the bottom half for a softirq number */
+void softirq_register(int nr, softirq_fn_t fn);
+
+/* Mark a softirq pending on this CPU (interrupts off, usually in an IRQ) */
+void softirq_raise(int nr);
+
+/**
+ * Run pending softirqs (interrupts off on entry and on return)
+ * Called by the IRQ dispatcher after the EOI. Does nothing when this
+ * CPU is already inside softirq_run() further up the stack.
+ */
+void softirq_run(void);
+
+/* Non-zero while this CPU is running softirqs (nested interrupts see it) */
+int softirq_active(void);
+
+#endif /* SOFTIRQ_H */
@@ -0,0 +1,55 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include "atomic.h"
+#include "cpu.h"
+
+/**
+ * Spinlocks
+ *
+ * Test-and-test-and-set: waiters spin on a plain read so the cache line
+ * stays shared until the holder releases it. Locks that an interrupt
+ * handler also takes must use the _irqsave variants, otherwise the
+ * handler can spin forever on a lock its own CPU holds.
+ */
+
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_lock_init(spinlock_t* lock) {
+    lock->locked = 0;
+}
+
+static inline int spin_trylock(spinlock_t* lock) {
+    return __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+static inline void spin_lock(spinlock_t* lock) {
+    while (!spin_trylock(lock)) {
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            cpu_relax();
+        }
+    }
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* Take the lock with local interrupts off; returns the saved EFLAGS */
+static inline uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = cpu_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    spin_unlock(lock);
+    cpu_irq_restore(flags);
+}
+
+#endif /* SPINLOCK_H */
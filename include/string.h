@@ -25,4 +25,10 @@ void *memset(void *ptr, int value, size_t size);
 /* Copy memory */
 void *memcpy(void *dest, const void *src, size_t size);
 
+/* Compare two blocks of memory */
+int memcmp(const void *s1, const void *s2, size_t size);
+
+/* Convert an unsigned integer to a string in the given base (2-16) */
+char *utoa(uint32_t value, char *buf, int base);
+
 #endif /* STRING_H */
@@ -7,6 +7,7 @@
 
 void taskbar_init(void);
 void taskbar_draw(void);
+int taskbar_needs_redraw(void);
 void taskbar_handle_click(int x, int y);
 
 #endif
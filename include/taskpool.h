@@ -0,0 +1,43 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <stdint.h>
+
+/**
+ * Work-stealing task pool
+ *
+ * Runs a batch of independent tasks on every online CPU. Each CPU has a
+ * deque of task indices: it takes work from its own end and, once that
+ * runs dry, steals from the other end of another CPU's deque. The batch
+ * is handed out in contiguous chunks, so neighbouring tasks (adjacent
+ * screen tiles) tend to stay on one CPU.
+ *
+ * Idle application processors halt and are woken with an IPI.
+ */
+
+#define TASKPOOL_DEQUE_SIZE   1024    /* Tasks per CPU per batch */
+#define TASKPOOL_MIN_PARALLEL 4       /* Smaller batches run on the caller */
+
+/* Interrupt vector of the wakeup IPI sent to application processors */
+#define TASKPOOL_WAKE_VECTOR  0xF0
+
+/* A task: called once per index in [0, count) */
+typedef void (*task_fn_t)(void* arg, int index);
+
+/* Set up the pool (after smp_init()) */
+void taskpool_init(void);
+
+/**
+ * Run fn(arg, i) for every i in [0, count) and wait for all to finish
+ * Tasks must be independent - they may run in any order, on any CPU.
+ * Only one thread may use the pool at a time.
+ */
+void taskpool_run(task_fn_t fn, void* arg, int count);
+
+/* Main loop of an application processor (never returns) */
+void taskpool_ap_main(void) __attribute__((noreturn));
+
+/* Wakeup IPI stub (interrupts.asm) */
+extern void taskpool_wake_stub(void);
+
+#endif /* TASKPOOL_H */
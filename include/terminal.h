@@ -2,15 +2,32 @@
 #define TERMINAL_H
 
 #include "window.h"
+#include "thread.h"
 
 #define TERM_COLS 80
 #define TERM_ROWS 24
 #define HISTORY_SIZE 16
 #define MAX_INPUT_LEN 256
 
+/* Lines kept after they scroll off the top (TERM_COLS bytes each) */
+#define TERM_SCROLLBACK 2000
+#define TERM_LINES (TERM_ROWS + TERM_SCROLLBACK)
+
+/* Lines moved per wheel detent */
+#define TERM_WHEEL_LINES 3
+
+/* Keys held back while a command runs */
+#define TERM_TYPEAHEAD 64
+
 typedef struct {
     window_t* window;
-    char buffer[TERM_ROWS][TERM_COLS + 1];
+    /* Ring of rows: screen row r is lines[(top + r) % TERM_LINES] and */
+    /* the scrollback sits just before top, so scrolling moves top only. */
+    /* Cells are '\0' when empty; rows have no terminator. */
+    char lines[TERM_LINES][TERM_COLS];
+    int top;
+    int scrollback;         /* Lines of history above the screen */
+    int view_offset;        /* Lines the view is scrolled back, 0 = live */
     int cursor_row;
     int cursor_col;
     color_t fg_color;
@@ -25,6 +42,15 @@ typedef struct {
     char saved_input[MAX_INPUT_LEN];
     int saved_input_pos;
     int browsing_history;
+    /* Command handed to the shell thread; keys typed while busy wait */
+    /* in the type-ahead ring and are replayed when it finishes */
+    char command[MAX_INPUT_LEN];
+    volatile int busy;
+    volatile int interrupted;   /* Ctrl-C while busy; polled by long commands */
+    wait_queue_t command_queue;
+    unsigned char typeahead[TERM_TYPEAHEAD];
+    int typeahead_head;
+    int typeahead_count;
 } terminal_t;
 
 terminal_t* terminal_create(int x, int y);
@@ -35,5 +61,6 @@ void terminal_clear(terminal_t* term);
 void terminal_draw(terminal_t* term);
 void terminal_handle_key(terminal_t* term, unsigned char key);
 void terminal_scroll(terminal_t* term);
+void terminal_scroll_view(terminal_t* term, int lines);   /* > 0 = back */
 
 #endif
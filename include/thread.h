@@ -0,0 +1,141 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+#include "idt.h"
+
+/**
+ * Preemptive kernel threads
+ *
+ * Each thread has its own stack. A thread's context is the registers_t
+ * frame the interrupt stubs already push: irq_handler() returns the frame
+ * to resume, and the stub switches esp to it before popping. Voluntary
+ * switches (yield, block, sleep) go through a software interrupt so they
+ * save exactly the same frame. The running thread is preempted when its
+ * time slice ends or an interrupt wakes another thread.
+ *
+ * Threads run on the bootstrap CPU, round-robin. Wait queues and the
+ * run queue are protected by disabling interrupts.
+ */
+
+#define THREAD_STACK_SIZE   16384
+#define THREAD_SLICE_MS     10
+#define THREAD_NAME_LEN     16
+
+/* Software interrupt used for voluntary switches (first vector after the ISA IRQs) */
+#define THREAD_YIELD_VECTOR 48
+
+typedef enum {
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_BLOCKED,     /* On a wait queue */
+    THREAD_SLEEPING,    /* On the sleep list until wake_ms */
+    THREAD_DEAD
+} thread_state_t;
+
+typedef struct thread {
+    uint8_t fpu_state[512] __attribute__((aligned(16)));    /* FXSAVE (or FSAVE) area */
+    registers_t* frame;         /* Saved context while not running */
+    void* stack;                /* Base of the kmalloc'd stack (0 for main) */
+    uint32_t id;
+    char name[THREAD_NAME_LEN];
+    thread_state_t state;
+    void (*entry)(void* arg);
+    void* arg;
+    uint64_t wake_ms;           /* Uptime to wake at while sleeping */
+    struct thread* next;        /* Run queue, wait queue or sleep list link */
+} thread_t;
+
+/* FIFO of blocked threads */
+typedef struct {
+    thread_t* head;
+    thread_t* tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT { 0, 0 }
+
+/*
+ * Sleeping lock. Recursive: the owner may take it again, and must
+ * unlock as many times.
+ */
+typedef struct {
+    thread_t* owner;
+    uint32_t depth;
+    wait_queue_t waiters;
+} mutex_t;
+
+#define MUTEX_INIT { 0, 0, WAIT_QUEUE_INIT }
+
+/**
+ * Turn the boot context into the "main" thread and start scheduling
+ * Call once, before interrupts are enabled.
+ */
+void thread_init(void);
+
+/**
+ * Non-zero once thread_init() has run
+ */
+int thread_scheduler_running(void);
+
+/**
+ * Create a thread and make it runnable
+ * @return The thread, or 0 if out of memory
+ */
+thread_t* thread_create(const char* name, void (*entry)(void* arg), void* arg);
+
+/**
+ * The calling thread
+ */
+thread_t* thread_current(void);
+
+/**
+ * Give up the CPU to the next ready thread
+ */
+void thread_yield(void);
+
+/**
+ * End the calling thread (also happens when its entry function returns)
+ */
+void thread_exit(void) __attribute__((noreturn));
+
+/**
+ * Block for at least ms milliseconds
+ */
+void thread_sleep_ms(uint32_t ms);
+
+/**
+ * Block until the next hardware interrupt - the thread version of hlt
+ * Call with interrupts disabled after checking for pending work, so
+ * nothing can arrive between the check and the wait.
+ */
+void thread_wait_interrupt(void);
+
+/**
+ * Wake the threads in thread_wait_interrupt() as if an interrupt arrived
+ * If none is waiting yet, the next thread_wait_interrupt() returns at once.
+ */
+void thread_wake_interrupt_waiters(void);
+
+/**
+ * Block on a wait queue. Call with interrupts disabled; they are
+ * disabled again on return. Re-check the condition in a loop.
+ */
+void thread_wait(wait_queue_t* queue);
+
+/**
+ * Make the first (or every) thread on a wait queue runnable
+ */
+void thread_wake_one(wait_queue_t* queue);
+void thread_wake_all(wait_queue_t* queue);
+
+void mutex_lock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+/* Scheduler hooks called by irq_handler() - return the frame to resume */
+registers_t* thread_irq_exit(registers_t* regs);
+registers_t* thread_yield_handler(registers_t* regs);
+
+/* Software interrupt stub for THREAD_YIELD_VECTOR (interrupts.asm) */
+extern void thread_yield_stub(void);
+
+#endif /* THREAD_H */
@@ -0,0 +1,54 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+/**
+ * System timer
+ *
+ * Boots on PIT channel 0, which drives IRQ0 at a fixed rate and keeps a
+ * 64-bit monotonic tick count. With a local APIC and a TSC the timer then
+ * goes tickless: the PIT is masked and the APIC timer (one-shot or
+ * TSC-deadline) only fires for the earliest requested wakeup, so an idle
+ * system stays halted. Waiting always halts the CPU instead of spinning.
+ */
+
+#define PIT_CHANNEL0     0x40
+#define PIT_CHANNEL2     0x42
+#define PIT_COMMAND_PORT 0x43
+#define PIT_GATE_PORT    0x61       /* Channel 2 gate and output (port B) */
+#define PIT_BASE_HZ      1193182    /* Input clock of the PIT */
+
+#define TIMER_DEFAULT_HZ 250        /* 4 ms ticks */
+#define TIMER_MIN_HZ     19         /* Slowest rate a 16-bit divisor allows */
+#define TIMER_MAX_HZ     10000
+
+/* Start channel 0 at hz interrupts per second and unmask IRQ0 */
+void timer_init(uint32_t hz);
+
+
+/* Tick rate actually programmed (after rounding the divisor) */
+uint32_t timer_get_frequency(void);
+
+/* Timer interrupts since timer_init() */
+uint64_t timer_get_ticks(void);
+
+/* Milliseconds since timer_init() */
+uint64_t timer_uptime_ms(void);
+
+/* Halt until at least ms milliseconds have passed (needs interrupts on) */
+void timer_sleep_ms(uint32_t ms);
+
+/* Switch to tickless APIC deadlines. Returns 0 on success */
+int timer_enable_tickless(void);
+int timer_is_tickless(void);
+
+/* Ensure an interrupt arrives by uptime ms (call before halting) */
+#define TIMER_NO_DEADLINE 0xFFFFFFFFFFFFFFFFULL
+void timer_wakeup_at(uint64_t ms);
+
+/* Polled one-shot countdown on channel 2 (ms <= 54), works with IRQs off */
+void timer_oneshot_start(uint32_t ms);
+int timer_oneshot_expired(void);
+
+#endif /* TIMER_H */
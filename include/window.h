@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "graphics.h"
+#include "region.h"
 
 #define MAX_WINDOWS 16
 #define TITLEBAR_HEIGHT 24
@@ -15,21 +16,42 @@ typedef struct window {
     int visible;
     int focused;
     color_t bg_color;
-    // Content buffer (optional - for now we'll draw directly)
+    // Off-screen backing store - re-rendered only when dirty is set
+    surface_t surface;
+    int dirty;
+    // Geometry as last composited, to damage the old area on move/resize
+    int drawn;
+    int drawn_x, drawn_y;
+    int drawn_width, drawn_height;
     void (*draw_content)(struct window* win);
-    void (*on_key)(struct window* win, unsigned char key);
+    void (*on_key)(struct window* win, unsigned char key, uint8_t modifiers);
+    // Mouse wheel over the window, in detents (positive = towards the user)
+    void (*on_wheel)(struct window* win, int delta);
 } window_t;
 
 // Window manager functions
 void wm_init(void);
-void wm_draw_all(void);
+void wm_collect_damage(region_t* exposed);
+int wm_needs_redraw(void);
+// Composite the damage: background fills bg_color, windows come from surfaces
+void wm_draw_all(const region_t* background, color_t bg_color);
 void wm_draw_window(window_t* win);
 window_t* wm_create_window(int x, int y, int width, int height, const char* title);
 void wm_destroy_window(window_t* win);
 void wm_focus_window(window_t* win);
 window_t* wm_get_focused(void);
 void wm_handle_mouse(int x, int y, int buttons);
-void wm_handle_key(unsigned char key);
+void wm_handle_key(unsigned char key, uint8_t modifiers);
+void wm_handle_wheel(int x, int y, int delta);
+
+// Mark a window's contents as changed so its surface is re-rendered
+void wm_invalidate(window_t* win);
+
+// Mark a screen area for recompositing on the next frame
+void wm_damage(int x, int y, int width, int height);
+
+// Refit windows into a new screen area after a resolution change
+void wm_screen_resized(int width, int height);
 
 // Draw window decorations
 void wm_draw_titlebar(window_t* win);
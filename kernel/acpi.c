@@ -0,0 +1,206 @@
+/*
+ * AJOS ACPI Table Discovery
+ * Locates the RSDP/RSDT and parses the MADT for APIC routing
+ */
+
+#include "acpi.h"
+#include "string.h"
+
+/* Root System Description Pointer (ACPI 2.0 layout, 1.0 uses the first 20 bytes) */
+typedef struct {
+    char signature[8];          /* "RSD PTR " */
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;           /* 0 = ACPI 1.0, 2+ = has XSDT */
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+/* Common header of every system description table */
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+/* MADT: header, then variable-length interrupt controller entries */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_addr;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_header_t;
+
+/* MADT entry types */
+#define MADT_LOCAL_APIC        0
+#define MADT_IO_APIC           1
+#define MADT_ISO               2   /* Interrupt source override */
+#define MADT_LAPIC_OVERRIDE    5
+
+#define MADT_LAPIC_ENABLED     0x01
+
+acpi_madt_t g_madt;
+
+/*
+ * Check that a block of bytes sums to zero
+ */
+static int acpi_checksum_ok(const void* data, uint32_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+/*
+ * Scan a physical range for the RSDP (it sits on a 16-byte boundary)
+ */
+static acpi_rsdp_t* acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + 20 <= end; addr += 16) {
+        acpi_rsdp_t* rsdp = (acpi_rsdp_t*)addr;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 &&
+            acpi_checksum_ok(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Find the RSDP in the EBDA or the BIOS ROM area
+ */
+static acpi_rsdp_t* acpi_find_rsdp(void) {
+    /* The BIOS data area holds the EBDA segment at 0x40E */
+    uint32_t ebda = (uint32_t)(*(uint16_t*)0x40E) << 4;
+    acpi_rsdp_t* rsdp = 0;
+
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(0xE0000, 0x100000);
+    }
+    return rsdp;
+}
+
+/*
+ * Find a table by signature in the RSDT or XSDT
+ */
+static acpi_sdt_header_t* acpi_find_table(acpi_rsdp_t* rsdp, const char* signature) {
+    acpi_sdt_header_t* root;
+    int entry_size;
+
+    if (rsdp->revision >= 2 && rsdp->xsdt_address != 0 &&
+        (rsdp->xsdt_address >> 32) == 0) {
+        root = (acpi_sdt_header_t*)(uint32_t)rsdp->xsdt_address;
+        entry_size = 8;
+    } else {
+        root = (acpi_sdt_header_t*)rsdp->rsdt_address;
+        entry_size = 4;
+    }
+    if (!acpi_checksum_ok(root, root->length)) {
+        return 0;
+    }
+
+    int count = (root->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    uint8_t* entries = (uint8_t*)root + sizeof(acpi_sdt_header_t);
+
+    for (int i = 0; i < count; i++) {
+        /* We run without paging - tables above 4GB are out of reach */
+        uint32_t addr = *(uint32_t*)(entries + i * entry_size);
+        if (entry_size == 8 && *(uint32_t*)(entries + i * entry_size + 4) != 0) {
+            continue;
+        }
+
+        acpi_sdt_header_t* table = (acpi_sdt_header_t*)addr;
+        if (memcmp(table->signature, signature, 4) == 0 &&
+            acpi_checksum_ok(table, table->length)) {
+            return table;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Parse the MADT entries into g_madt
+ */
+static void acpi_parse_madt(acpi_madt_header_t* madt) {
+    g_madt.lapic_addr = madt->lapic_addr;
+
+    uint8_t* entry = (uint8_t*)madt + sizeof(acpi_madt_header_t);
+    uint8_t* end = (uint8_t*)madt + madt->header.length;
+
+    while (entry + 2 <= end && entry[1] >= 2 && entry + entry[1] <= end) {
+        switch (entry[0]) {
+            case MADT_LOCAL_APIC:
+                /* acpi_id, apic_id, flags */
+                if ((*(uint32_t*)(entry + 4) & MADT_LAPIC_ENABLED) &&
+                    g_madt.cpu_count < ACPI_MAX_CPUS) {
+                    g_madt.cpu_apic_ids[g_madt.cpu_count++] = entry[3];
+                }
+                break;
+
+            case MADT_IO_APIC:
+                /* id, reserved, address, gsi_base */
+                if (!g_madt.ioapic_found) {
+                    g_madt.ioapic_found = 1;
+                    g_madt.ioapic_id = entry[2];
+                    g_madt.ioapic_addr = *(uint32_t*)(entry + 4);
+                    g_madt.ioapic_gsi_base = *(uint32_t*)(entry + 8);
+                }
+                break;
+
+            case MADT_ISO:
+                /* bus, source irq, gsi, flags */
+                if (entry[3] < ACPI_ISA_IRQS) {
+                    g_madt.isa_gsi[entry[3]] = *(uint32_t*)(entry + 4);
+                    g_madt.isa_flags[entry[3]] = *(uint16_t*)(entry + 8);
+                }
+                break;
+
+            case MADT_LAPIC_OVERRIDE:
+                /* reserved, 64-bit address */
+                if (*(uint32_t*)(entry + 8) == 0) {
+                    g_madt.lapic_addr = *(uint32_t*)(entry + 4);
+                }
+                break;
+        }
+        entry += entry[1];
+    }
+}
+
+/*
+ * Locate ACPI tables and parse the MADT
+ * Returns 0 on success, -1 if there is no usable MADT
+ */
+int acpi_init(void) {
+    memset(&g_madt, 0, sizeof(g_madt));
+
+    /* ISA IRQs map 1:1 onto GSIs unless overridden */
+    for (int i = 0; i < ACPI_ISA_IRQS; i++) {
+        g_madt.isa_gsi[i] = i;
+    }
+
+    acpi_rsdp_t* rsdp = acpi_find_rsdp();
+    if (!rsdp) {
+        return -1;
+    }
+
+    acpi_madt_header_t* madt = (acpi_madt_header_t*)acpi_find_table(rsdp, "APIC");
+    if (!madt) {
+        return -1;
+    }
+
+    acpi_parse_madt(madt);
+    g_madt.valid = 1;
+    return 0;
+}
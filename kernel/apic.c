@@ -0,0 +1,215 @@
+/*
+ * AJOS APIC Driver
+ * Local APIC and I/O APIC interrupt delivery
+ */
+
+#include "apic.h"
+#include "acpi.h"
+#include "cpu.h"
+#include "idt.h"
+
+/* I/O APIC: an index register and a data window */
+#define IOAPIC_REGSEL       0x00
+#define IOAPIC_WINDOW       0x10
+
+#define IOAPIC_REG_VERSION  0x01
+#define IOAPIC_REG_REDTBL   0x10    /* Two 32-bit registers per entry */
+
+/* Redirection entry low-word bits */
+#define IOAPIC_ACTIVE_LOW   (1 << 13)
+#define IOAPIC_LEVEL        (1 << 15)
+#define IOAPIC_MASKED       (1 << 16)
+
+static volatile uint32_t* lapic = 0;
+static volatile uint32_t* ioapic = 0;
+static uint32_t ioapic_entries = 0;
+static int enabled = 0;
+
+/*
+ * Read a local APIC register
+ */
+uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+/*
+ * Write a local APIC register
+ */
+void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+/*
+ * Read an I/O APIC register
+ */
+static uint32_t ioapic_read(uint32_t reg) {
+    ioapic[IOAPIC_REGSEL / 4] = reg;
+    return ioapic[IOAPIC_WINDOW / 4];
+}
+
+/*
+ * Write an I/O APIC register
+ */
+static void ioapic_write(uint32_t reg, uint32_t value) {
+    ioapic[IOAPIC_REGSEL / 4] = reg;
+    ioapic[IOAPIC_WINDOW / 4] = value;
+}
+
+/*
+ * Check whether an identity-mapped ISA IRQ lost its pin to an override
+ * (typically IRQ 2, whose GSI the PIT's IRQ 0 is redirected to)
+ */
+static int ioapic_pin_overridden(uint8_t irq) {
+    if (g_madt.isa_gsi[irq] != irq) return 0;
+
+    for (uint8_t other = 0; other < ACPI_ISA_IRQS; other++) {
+        if (other != irq && g_madt.isa_gsi[other] == irq) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Get the I/O APIC pin an ISA IRQ arrives on, or -1 if it is not ours
+ */
+static int ioapic_pin(uint8_t irq) {
+    if (irq >= ACPI_ISA_IRQS || ioapic_pin_overridden(irq)) return -1;
+
+    uint32_t gsi = g_madt.isa_gsi[irq];
+    if (gsi < g_madt.ioapic_gsi_base || gsi - g_madt.ioapic_gsi_base >= ioapic_entries) {
+        return -1;
+    }
+    return gsi - g_madt.ioapic_gsi_base;
+}
+
+/*
+ * Route an ISA IRQ to vector 32 + irq on the given CPU, initially masked
+ * ISA interrupts are active-high and edge-triggered unless the MADT says otherwise
+ */
+static void ioapic_route_isa(uint8_t irq, uint8_t dest_apic_id) {
+    int pin = ioapic_pin(irq);
+    if (pin < 0) return;
+
+    uint32_t low = (APIC_IRQ_BASE_VECTOR + irq) | IOAPIC_MASKED;
+    uint16_t flags = g_madt.isa_flags[irq];
+    if ((flags & ACPI_POLARITY_MASK) == ACPI_POLARITY_LOW) low |= IOAPIC_ACTIVE_LOW;
+    if ((flags & ACPI_TRIGGER_MASK) == ACPI_TRIGGER_LEVEL) low |= IOAPIC_LEVEL;
+
+    ioapic_write(IOAPIC_REG_REDTBL + pin * 2 + 1, (uint32_t)dest_apic_id << 24);
+    ioapic_write(IOAPIC_REG_REDTBL + pin * 2, low);
+}
+
+/*
+ * Enable the local APIC of the calling CPU
+ */
+static void lapic_enable(void) {
+    cpu_wrmsr(MSR_APIC_BASE, cpu_rdmsr(MSR_APIC_BASE) | MSR_APIC_BASE_ENABLE);
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    /* Legacy virtual-wire input from the 8259 is no longer used */
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+
+    /* Clear any stale errors (write before read) */
+    lapic_write(LAPIC_ESR, 0);
+    lapic_read(LAPIC_ESR);
+}
+
+/*
+ * Switch interrupt delivery from the 8259 PIC to the APICs
+ * The PIC must already be remapped so stray legacy interrupts stay off
+ * the exception vectors. Call with interrupts disabled.
+ * Returns 0 on success, -1 if there is no usable APIC (PIC stays in charge)
+ */
+int apic_init(void) {
+    if (!cpu_has_feature_edx(CPUID_EDX_APIC)) {
+        return -1;
+    }
+    if (acpi_init() != 0 || !g_madt.ioapic_found || g_madt.lapic_addr == 0) {
+        return -1;
+    }
+
+    lapic = (volatile uint32_t*)g_madt.lapic_addr;
+    ioapic = (volatile uint32_t*)g_madt.ioapic_addr;
+    ioapic_entries = ((ioapic_read(IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint32_t)apic_spurious_stub, 0x08, IDT_INTERRUPT_GATE);
+    lapic_enable();
+
+    /* Everything masked until a driver asks for its IRQ */
+    for (uint32_t pin = 0; pin < ioapic_entries; pin++) {
+        ioapic_write(IOAPIC_REG_REDTBL + pin * 2, IOAPIC_MASKED);
+    }
+
+    uint8_t bsp = lapic_get_id();
+    for (uint8_t irq = 0; irq < ACPI_ISA_IRQS; irq++) {
+        if (!ioapic_pin_overridden(irq)) {
+            ioapic_route_isa(irq, bsp);
+        }
+    }
+
+    enabled = 1;
+    return 0;
+}
+
+/*
+ * Enable the local APIC on an application processor
+ * The I/O APIC is shared and already set up by the BSP.
+ */
+void apic_init_ap(void) {
+    lapic_enable();
+}
+
+/*
+ * Check whether the APIC is delivering interrupts
+ */
+int apic_is_enabled(void) {
+    return enabled;
+}
+
+/*
+ * Get the local APIC ID of the calling CPU
+ */
+uint8_t lapic_get_id(void) {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+/*
+ * Send an IPI to the CPU with the given APIC ID
+ * Waits until the local APIC has accepted it.
+ */
+void lapic_send_ipi(uint8_t apic_id, uint32_t icr_low) {
+    uint32_t flags = cpu_irq_save();
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, icr_low);
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile ("pause");
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Signal end of interrupt
+ */
+void apic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ * Mask or unmask an ISA IRQ at the I/O APIC
+ */
+void ioapic_set_masked(uint8_t irq, int masked) {
+    int pin = ioapic_pin(irq);
+    if (!enabled || pin < 0) return;
+
+    uint32_t low = ioapic_read(IOAPIC_REG_REDTBL + pin * 2);
+    if (masked) {
+        low |= IOAPIC_MASKED;
+    } else {
+        low &= ~IOAPIC_MASKED;
+    }
+    ioapic_write(IOAPIC_REG_REDTBL + pin * 2, low);
+}
@@ -0,0 +1,96 @@
+/*
+ * AJOS Bochs Graphics Adapter Driver
+ * Runtime mode switching through the VBE DISPI I/O ports
+ */
+
+#include "bga.h"
+#include "io.h"
+
+static void bga_write(uint16_t reg, uint16_t value) {
+    outw(BGA_PORT_INDEX, reg);
+    outw(BGA_PORT_DATA, value);
+}
+
+static uint16_t bga_read(uint16_t reg) {
+    outw(BGA_PORT_INDEX, reg);
+    return inw(BGA_PORT_DATA);
+}
+
+/*
+ * Check for a BGA-compatible adapter
+ * Returns 1 if the ID register reports a known interface version
+ */
+int bga_is_available(void) {
+    uint16_t id = bga_read(BGA_REG_ID);
+    return id >= BGA_ID_MIN && id <= BGA_ID_MAX;
+}
+
+/*
+ * Get the amount of video memory
+ * Returns bytes, or 0 if the adapter is too old to report it
+ */
+uint32_t bga_get_vram_size(void) {
+    if (bga_read(BGA_REG_ID) < 0xB0C2) {
+        return 0;
+    }
+    return (uint32_t)bga_read(BGA_REG_VIDEO_MEMORY) << 16;
+}
+
+/*
+ * Switch to a linear framebuffer mode
+ * The framebuffer stays at the same physical address GRUB gave us.
+ * Returns 0 on success, -1 if the adapter rejected the mode.
+ */
+int bga_set_mode(uint16_t width, uint16_t height, uint16_t bpp) {
+    if (!bga_is_available() || width == 0 || height == 0 ||
+        width > BGA_MAX_XRES || height > BGA_MAX_YRES) {
+        return -1;
+    }
+
+    uint32_t vram = bga_get_vram_size();
+    if (vram != 0 && (uint32_t)width * height * (bpp / 8) > vram) {
+        return -1;
+    }
+
+    /* Registers may only be changed while the display is disabled */
+    bga_write(BGA_REG_ENABLE, BGA_DISABLED);
+    bga_write(BGA_REG_XRES, width);
+    bga_write(BGA_REG_YRES, height);
+    bga_write(BGA_REG_BPP, bpp);
+    bga_write(BGA_REG_ENABLE, BGA_ENABLED | BGA_LFB_ENABLED);
+
+    /* The adapter clamps unsupported values - check what we got */
+    if (bga_read(BGA_REG_XRES) != width || bga_read(BGA_REG_YRES) != height ||
+        bga_read(BGA_REG_BPP) != bpp) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Make the virtual screen height lines tall (same width as the display)
+ * Returns 0 on success, -1 if there is not enough video memory
+ */
+int bga_set_virtual_height(uint16_t height) {
+    if (!bga_is_available()) {
+        return -1;
+    }
+
+    uint16_t width = bga_read(BGA_REG_XRES);
+    bga_write(BGA_REG_VIRT_WIDTH, width);
+    bga_write(BGA_REG_VIRT_HEIGHT, height);
+
+    /* The adapter shrinks the virtual screen to what fits in VRAM */
+    if (bga_read(BGA_REG_VIRT_WIDTH) != width ||
+        bga_read(BGA_REG_VIRT_HEIGHT) < height) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Scroll the display to start at line y of the virtual screen
+ */
+void bga_set_y_offset(uint16_t y) {
+    bga_write(BGA_REG_Y_OFFSET, y);
+}
@@ -0,0 +1,146 @@
+/*
+ * AJOS High-Resolution Clock
+ * Time-stamp counter calibrated against the PIT
+ */
+
+#include "clock.h"
+#include "cpu.h"
+#include "timer.h"
+
+static uint32_t tsc_khz = 0;
+static uint64_t tsc_base = 0;     /* TSC at clock_init() */
+
+/* Nanoseconds per cycle as 32.32 fixed point */
+static uint32_t ns_whole = 0;
+static uint32_t ns_frac = 0;
+
+/*
+ * Compute value * (whole + frac / 2^32) without 128-bit arithmetic
+ * Only 32x32->64 multiplies, so no libgcc helpers are needed.
+ */
+static uint64_t scale_fixed(uint64_t value, uint32_t whole, uint32_t frac) {
+    uint32_t hi = (uint32_t)(value >> 32);
+    uint32_t lo = (uint32_t)value;
+
+    return value * whole +
+           (uint64_t)hi * frac +
+           (((uint64_t)lo * frac) >> 32);
+}
+
+/*
+ * Divide a 64-bit value by a 32-bit one with two divl steps
+ * (plain 64-bit division would need libgcc's __udivdi3)
+ */
+uint64_t div64_32(uint64_t value, uint32_t divisor) {
+    uint32_t hi = (uint32_t)(value >> 32);
+    uint32_t lo = (uint32_t)value;
+    uint32_t q_hi = hi / divisor;
+    uint32_t rem = hi % divisor;
+    uint32_t q_lo;
+
+    __asm__ ("divl %2"
+             : "=a"(q_lo), "=d"(rem)
+             : "rm"(divisor), "a"(lo), "d"(rem));
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+/*
+ * Calibrate the TSC against a PIT channel 2 one-shot
+ * Interrupts are off for the window so nothing stretches the measurement.
+ */
+void clock_init(void) {
+    if (!cpu_has_feature_edx(CPUID_EDX_TSC)) {
+        return;
+    }
+
+    uint32_t flags = cpu_irq_save();
+    timer_oneshot_start(CLOCK_CALIBRATE_MS);
+    uint64_t start = cpu_rdtsc();
+    while (!timer_oneshot_expired());
+    uint64_t end = cpu_rdtsc();
+    cpu_irq_restore(flags);
+
+    /* A 50 ms window fits in 32 bits for any CPU below ~85 GHz */
+    uint32_t elapsed = (uint32_t)(end - start);
+    tsc_khz = elapsed / CLOCK_CALIBRATE_MS;
+    if (tsc_khz == 0) {
+        return;
+    }
+
+    /* ns per cycle = 10^6 / khz, split into whole and 2^-32 parts */
+    uint32_t rem;
+    ns_whole = 1000000 / tsc_khz;
+    rem = 1000000 % tsc_khz;
+    __asm__ ("divl %2"
+             : "=a"(ns_frac), "=d"(rem)
+             : "rm"(tsc_khz), "a"(0), "d"(rem));
+
+    tsc_base = cpu_rdtsc();
+}
+
+/*
+ * Get the calibrated TSC frequency in kHz
+ */
+uint32_t clock_get_tsc_khz(void) {
+    return tsc_khz;
+}
+
+/*
+ * Read the cycle counter
+ */
+uint64_t clock_cycles(void) {
+    return tsc_khz ? cpu_rdtsc() : 0;
+}
+
+/*
+ * Convert TSC cycles to nanoseconds
+ */
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    return scale_fixed(cycles, ns_whole, ns_frac);
+}
+
+/*
+ * Nanoseconds since clock_init()
+ * Without a TSC this only advances once per timer tick.
+ */
+uint64_t clock_now_ns(void) {
+    if (!tsc_khz) {
+        return timer_uptime_ms() * 1000000;
+    }
+    return scale_fixed(cpu_rdtsc() - tsc_base, ns_whole, ns_frac);
+}
+
+/*
+ * Milliseconds since clock_init()
+ */
+uint64_t clock_now_ms(void) {
+    if (!tsc_khz) {
+        return timer_uptime_ms();
+    }
+    return div64_32(clock_now_ns(), 1000000);
+}
+
+/*
+ * Absolute TSC value ms milliseconds after clock_init()
+ */
+uint64_t clock_ms_to_tsc(uint64_t ms) {
+    return tsc_base + ms * tsc_khz;
+}
+
+/*
+ * Busy-wait for at least us microseconds
+ * Works with interrupts off. Without a TSC the PIT one-shot is used,
+ * rounded up to whole milliseconds.
+ */
+void clock_delay_us(uint32_t us) {
+    if (!tsc_khz) {
+        timer_oneshot_start((us + 999) / 1000);
+        while (!timer_oneshot_expired());
+        return;
+    }
+
+    uint64_t end = cpu_rdtsc() + div64_32((uint64_t)us * tsc_khz, 1000);
+    while (cpu_rdtsc() < end) {
+        __asm__ volatile ("pause");
+    }
+}
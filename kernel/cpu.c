@@ -0,0 +1,81 @@
+/*
+ * AJOS CPU Feature Detection
+ * Reads CPUID and enables optional instruction set state (SSE)
+ */
+
+#include "../include/cpu.h"
+
+/* Control register bits */
+#define CR0_MP          (1 << 1)    /* Monitor coprocessor */
+#define CR0_EM          (1 << 2)    /* x87 emulation - must be clear for SSE */
+#define CR4_OSFXSR      (1 << 9)    /* OS supports FXSAVE/FXRSTOR */
+#define CR4_OSXMMEXCPT  (1 << 10)   /* OS handles SIMD exceptions */
+
+cpu_info_t g_cpu = {
+    .vendor = "",
+    .max_leaf = 0,
+    .features_edx = 0,
+    .features_ecx = 0,
+    .sse_enabled = 0
+};
+
+/*
+ * Turn on SSE by setting up CR0 and CR4
+ */
+static void cpu_enable_sse(void) {
+    uint32_t cr0, cr4;
+
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP;
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(cr0));
+
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(cr4));
+
+    g_cpu.sse_enabled = 1;
+}
+
+/*
+ * Detect CPU vendor and feature flags
+ */
+void cpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    /* Leaf 0: highest leaf and vendor string (EBX, EDX, ECX order) */
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    g_cpu.max_leaf = eax;
+    *((uint32_t*)&g_cpu.vendor[0]) = ebx;
+    *((uint32_t*)&g_cpu.vendor[4]) = edx;
+    *((uint32_t*)&g_cpu.vendor[8]) = ecx;
+    g_cpu.vendor[12] = '\0';
+
+    /* Leaf 1: feature flags */
+    if (g_cpu.max_leaf >= 1) {
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+        g_cpu.features_edx = edx;
+        g_cpu.features_ecx = ecx;
+    }
+
+    if (cpu_has_feature_edx(CPUID_EDX_SSE)) {
+        cpu_enable_sse();
+    }
+}
+
+/*
+ * Enable the same CPU state on an application processor
+ * CR0/CR4 are per CPU; the feature flags were read by cpu_init().
+ */
+void cpu_init_ap(void) {
+    if (g_cpu.sse_enabled) {
+        cpu_enable_sse();
+    }
+}
+
+/*
+ * Check a CPUID leaf 1 EDX feature bit
+ */
+int cpu_has_feature_edx(uint32_t bit) {
+    return (g_cpu.features_edx & bit) != 0;
+}
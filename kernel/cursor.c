@@ -0,0 +1,150 @@
+/*
+ * AJOS Cursor Overlay
+ * Save-under mouse cursor drawn directly on the front buffer
+ */
+
+#include "cursor.h"
+#include "graphics.h"
+#include "cpu.h"
+
+/* Mouse cursor bitmap (1 = white, 2 = black, 0 = transparent) */
+static const uint8_t cursor_bitmap[CURSOR_HEIGHT][CURSOR_WIDTH] = {
+    {2,0,0,0,0,0,0,0,0,0,0,0},
+    {2,2,0,0,0,0,0,0,0,0,0,0},
+    {2,1,2,0,0,0,0,0,0,0,0,0},
+    {2,1,1,2,0,0,0,0,0,0,0,0},
+    {2,1,1,1,2,0,0,0,0,0,0,0},
+    {2,1,1,1,1,2,0,0,0,0,0,0},
+    {2,1,1,1,1,1,2,0,0,0,0,0},
+    {2,1,1,1,1,1,1,2,0,0,0,0},
+    {2,1,1,1,1,1,1,1,2,0,0,0},
+    {2,1,1,1,1,1,1,1,1,2,0,0},
+    {2,1,1,1,1,1,1,1,1,1,2,0},
+    {2,1,1,1,1,1,1,2,2,2,2,2},
+    {2,1,1,1,2,1,1,2,0,0,0,0},
+    {2,1,1,2,0,2,1,1,2,0,0,0},
+    {2,1,2,0,0,2,1,1,2,0,0,0},
+    {2,2,0,0,0,0,2,1,1,2,0,0},
+    {2,0,0,0,0,0,2,1,1,2,0,0},
+    {0,0,0,0,0,0,0,2,1,2,0,0},
+    {0,0,0,0,0,0,0,0,2,0,0,0},
+};
+
+/* Overlay state */
+static int enabled = 0;
+static int shown = 0;                   /* Sprite is on the front buffer */
+static int shown_x, shown_y;            /* Where it was drawn */
+static int shown_w, shown_h;            /* Clipped size of the saved area */
+static volatile int want_x, want_y;     /* Latest requested position */
+static volatile int presenting = 0;     /* Present owns the front buffer */
+
+/* Pixels under the sprite (and scratch for compositing it) */
+static uint32_t save_under[CURSOR_WIDTH * CURSOR_HEIGHT];
+static uint32_t sprite[CURSOR_WIDTH * CURSOR_HEIGHT];
+
+/*
+ * Put back the pixels the sprite covered
+ */
+static void cursor_hide(void) {
+    if (!shown) return;
+    graphics_front_write(shown_x, shown_y, shown_w, shown_h, save_under, CURSOR_WIDTH);
+    shown = 0;
+}
+
+/*
+ * Save the pixels at (x, y) and draw the sprite over them
+ */
+static void cursor_show(int x, int y) {
+    int w = CURSOR_WIDTH;
+    int h = CURSOR_HEIGHT;
+    if (x + w > (int)graphics_get_width()) w = graphics_get_width() - x;
+    if (y + h > (int)graphics_get_height()) h = graphics_get_height() - y;
+    if (x < 0 || y < 0 || w <= 0 || h <= 0) return;
+
+    graphics_front_read(x, y, w, h, save_under, CURSOR_WIDTH);
+
+    /* Compose sprite over the saved pixels, then write it in one go */
+    for (int row = 0; row < h; row++) {
+        for (int col = 0; col < w; col++) {
+            int i = row * CURSOR_WIDTH + col;
+            uint8_t pixel = cursor_bitmap[row][col];
+            if (pixel == 1) {
+                sprite[i] = COLOR_WHITE;
+            } else if (pixel == 2) {
+                sprite[i] = COLOR_BLACK;
+            } else {
+                sprite[i] = save_under[i];  /* Transparent */
+            }
+        }
+    }
+    graphics_front_write(x, y, w, h, sprite, CURSOR_WIDTH);
+
+    shown = 1;
+    shown_x = x;
+    shown_y = y;
+    shown_w = w;
+    shown_h = h;
+}
+
+/*
+ * Enable the overlay and draw the cursor
+ */
+void cursor_init(int x, int y) {
+    uint32_t flags = cpu_irq_save();
+    want_x = x;
+    want_y = y;
+    enabled = 1;
+    cursor_show(x, y);
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Move the cursor
+ * While a present is writing the front buffer the move is only recorded;
+ * cursor_present_end() draws it at the latest position.
+ */
+void cursor_move(int x, int y) {
+    uint32_t flags = cpu_irq_save();
+    want_x = x;
+    want_y = y;
+
+    if (enabled && !presenting && (!shown || x != shown_x || y != shown_y)) {
+        cursor_hide();
+        cursor_show(x, y);
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * A present is about to write the front buffer
+ */
+void cursor_present_begin(void) {
+    presenting = 1;
+}
+
+/*
+ * A present will overwrite [x1, x2) x [y1, y2)
+ * Take the sprite off first if it overlaps, so the save-under stays valid
+ */
+void cursor_present_rect(int x1, int y1, int x2, int y2) {
+    uint32_t flags = cpu_irq_save();
+    if (shown &&
+        x1 < shown_x + shown_w && shown_x < x2 &&
+        y1 < shown_y + shown_h && shown_y < y2) {
+        cursor_hide();
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Present finished - redraw the cursor at its latest position
+ */
+void cursor_present_end(void) {
+    uint32_t flags = cpu_irq_save();
+    presenting = 0;
+    if (enabled && (!shown || want_x != shown_x || want_y != shown_y)) {
+        cursor_hide();
+        cursor_show(want_x, want_y);
+    }
+    cpu_irq_restore(flags);
+}
@@ -9,35 +9,14 @@
 #include "taskbar.h"
 #include "terminal.h"
 #include "mouse.h"
-#include "keyboard.h"
+#include "input.h"
+#include "latency.h"
+#include "clock.h"
 #include "font.h"
-
-/* Mouse cursor dimensions */
-#define CURSOR_WIDTH  12
-#define CURSOR_HEIGHT 19
-
-/* Mouse cursor bitmap (1 = white, 2 = black, 0 = transparent) */
-static const uint8_t cursor_bitmap[CURSOR_HEIGHT][CURSOR_WIDTH] = {
-    {2,0,0,0,0,0,0,0,0,0,0,0},
-    {2,2,0,0,0,0,0,0,0,0,0,0},
-    {2,1,2,0,0,0,0,0,0,0,0,0},
-    {2,1,1,2,0,0,0,0,0,0,0,0},
-    {2,1,1,1,2,0,0,0,0,0,0,0},
-    {2,1,1,1,1,2,0,0,0,0,0,0},
-    {2,1,1,1,1,1,2,0,0,0,0,0},
-    {2,1,1,1,1,1,1,2,0,0,0,0},
-    {2,1,1,1,1,1,1,1,2,0,0,0},
-    {2,1,1,1,1,1,1,1,1,2,0,0},
-    {2,1,1,1,1,1,1,1,1,1,2,0},
-    {2,1,1,1,1,1,1,2,2,2,2,2},
-    {2,1,1,1,2,1,1,2,0,0,0,0},
-    {2,1,1,2,0,2,1,1,2,0,0,0},
-    {2,1,2,0,0,2,1,1,2,0,0,0},
-    {2,2,0,0,0,0,2,1,1,2,0,0},
-    {2,0,0,0,0,0,2,1,1,2,0,0},
-    {0,0,0,0,0,0,0,2,1,2,0,0},
-    {0,0,0,0,0,0,0,0,2,0,0,0},
-};
+#include "region.h"
+#include "cursor.h"
+#include "timer.h"
+#include "thread.h"
 
 /* Desktop state */
 static int initialized = 0;
@@ -72,22 +51,13 @@ static int resize_start_y = 0;
 static int resize_start_w = 0;
 static int resize_start_h = 0;
 
-/*
- * Draw the mouse cursor at the given position
- */
-static void draw_cursor(int x, int y) {
-    for (int row = 0; row < CURSOR_HEIGHT; row++) {
-        for (int col = 0; col < CURSOR_WIDTH; col++) {
-            uint8_t pixel = cursor_bitmap[row][col];
-            if (pixel == 1) {
-                draw_pixel(x + col, y + row, COLOR_WHITE);
-            } else if (pixel == 2) {
-                draw_pixel(x + col, y + row, COLOR_BLACK);
-            }
-            /* pixel == 0 is transparent, skip */
-        }
-    }
-}
+/* Serializes window, terminal and screen state between threads */
+static mutex_t desktop_mutex = MUTEX_INIT;
+static thread_t* desktop_thread = 0;
+
+/* Frame pacing */
+static int frame_rate = DESKTOP_FRAME_RATE;
+static uint32_t frame_interval_ms = 1000 / DESKTOP_FRAME_RATE;
 
 /*
  * Initialize the desktop environment
@@ -107,33 +77,91 @@ void desktop_init(void) {
     /* Create initial terminal window */
     main_terminal = terminal_create(100, 80);
 
+    /* Show the cursor overlay - mouse movement updates it directly */
+    cursor_init(mouse_get_x(), mouse_get_y());
+
     initialized = 1;
 }
 
+/*
+ * Take the desktop lock
+ * Any thread other than the desktop loop must hold it while touching
+ * windows, the terminal or the screen. It may be taken recursively.
+ */
+void desktop_lock(void) {
+    mutex_lock(&desktop_mutex);
+}
+
+/*
+ * Release the desktop lock
+ * When another thread changed something, the desktop loop is woken so
+ * the change reaches the screen without waiting for an interrupt - once,
+ * when the outermost lock is dropped.
+ */
+void desktop_unlock(void) {
+    mutex_unlock(&desktop_mutex);
+    if (desktop_thread && thread_current() != desktop_thread &&
+        desktop_mutex.owner != thread_current()) {
+        thread_wake_interrupt_waiters();
+    }
+}
+
+/*
+ * Change the screen resolution
+ * Resizes the framebuffer, then makes the mouse, taskbar and windows
+ * follow the new geometry. The next frame repaints everything.
+ * Returns 0 on success, -1 if the mode could not be set
+ */
+int desktop_set_resolution(uint32_t width, uint32_t height) {
+    desktop_lock();
+    if (graphics_set_mode(width, height) != 0) {
+        desktop_unlock();
+        return -1;
+    }
+
+    /* Any drag in progress refers to the old layout */
+    dragging_window = 0;
+    resizing_window = 0;
+    resize_edge = RESIZE_NONE;
+
+    mouse_set_bounds(width, height);
+    taskbar_init();
+    wm_screen_resized(width, height - TASKBAR_HEIGHT);
+    desktop_unlock();
+    return 0;
+}
+
 /*
  * Draw the entire desktop
  */
 void desktop_draw(void) {
+    static region_t exposed;
+    uint64_t start = clock_cycles();
+
     /* Get screen dimensions */
+    int screen_w = graphics_get_width();
     int screen_h = graphics_get_height();
 
-    /* Clear screen to desktop background color */
-    /* Only clear the area above the taskbar */
-    draw_filled_rect(0, 0, graphics_get_width(), screen_h - TASKBAR_HEIGHT, DESKTOP_BG_COLOR);
+    /* Find what changed and which of it is not covered by windows */
+    wm_collect_damage(&exposed);
+
+    /* Exposed desktop background (only the area above the taskbar) */
+    rect_t desktop_area = rect_make(0, 0, screen_w, screen_h - TASKBAR_HEIGHT);
+    region_intersect_rect(&exposed, &desktop_area);
 
-    /* Draw all windows */
-    wm_draw_all();
+    /* Composite background and windows over the damaged area, in tiles */
+    wm_draw_all(&exposed, DESKTOP_BG_COLOR);
 
     /* Draw taskbar */
     taskbar_draw();
 
-    /* Draw mouse cursor on top of everything */
-    int mx = mouse_get_x();
-    int my = mouse_get_y();
-    draw_cursor(mx, my);
-
     /* Swap buffers to display the frame */
+    /* The cursor is an overlay on the front buffer, not part of the scene */
+    uint64_t composed = clock_cycles();
     graphics_swap_buffers();
+
+    /* Input handled since the last frame is on screen now */
+    latency_frame(start, composed, clock_cycles());
 }
 
 /*
@@ -199,168 +227,295 @@ static window_t* find_window_at(int x, int y) {
 }
 
 /*
- * Main desktop loop
- * This function never returns - it continuously:
- * 1. Draws the desktop
- * 2. Handles keyboard input
- * 3. Handles mouse input
+ * Act on a mouse event: clicks, window dragging and resizing
  */
-void desktop_run(void) {
-    if (!initialized) {
-        desktop_init();
-    }
-
-    while (1) {
-        /* Draw the desktop */
-        desktop_draw();
-
-        /* Handle keyboard input */
-        char key = keyboard_getchar_nonblocking();
-        if (key != 0) {
-            /* Forward to focused window */
-            wm_handle_key(key);
+static void desktop_handle_mouse(int mx, int my, int buttons) {
+    int left_pressed = buttons & MOUSE_LEFT_BUTTON;
+    int was_left_pressed = prev_mouse_buttons & MOUSE_LEFT_BUTTON;
+
+    /* Handle resizing */
+    if (resizing_window && left_pressed) {
+        /* Continue resizing */
+        int dx = mx - resize_start_mx;
+        int dy = my - resize_start_my;
+
+        int new_x = resize_start_x;
+        int new_y = resize_start_y;
+        int new_w = resize_start_w;
+        int new_h = resize_start_h;
+
+        if (resize_edge & RESIZE_LEFT) {
+            new_x = resize_start_x + dx;
+            new_w = resize_start_w - dx;
+        }
+        if (resize_edge & RESIZE_RIGHT) {
+            new_w = resize_start_w + dx;
+        }
+        if (resize_edge & RESIZE_TOP) {
+            new_y = resize_start_y + dy;
+            new_h = resize_start_h - dy;
+        }
+        if (resize_edge & RESIZE_BOTTOM) {
+            new_h = resize_start_h + dy;
         }
 
-        /* Handle mouse input */
-        int mx = mouse_get_x();
-        int my = mouse_get_y();
-        int buttons = 0;
-        if (mouse_left_pressed()) buttons |= MOUSE_LEFT_BUTTON;
-        if (mouse_right_pressed()) buttons |= MOUSE_RIGHT_BUTTON;
-
-        int left_pressed = buttons & MOUSE_LEFT_BUTTON;
-        int was_left_pressed = prev_mouse_buttons & MOUSE_LEFT_BUTTON;
-
-        /* Handle resizing */
-        if (resizing_window && left_pressed) {
-            /* Continue resizing */
-            int dx = mx - resize_start_mx;
-            int dy = my - resize_start_my;
-
-            int new_x = resize_start_x;
-            int new_y = resize_start_y;
-            int new_w = resize_start_w;
-            int new_h = resize_start_h;
-
+        /* Enforce minimum size */
+        if (new_w < MIN_WINDOW_WIDTH) {
             if (resize_edge & RESIZE_LEFT) {
-                new_x = resize_start_x + dx;
-                new_w = resize_start_w - dx;
-            }
-            if (resize_edge & RESIZE_RIGHT) {
-                new_w = resize_start_w + dx;
+                new_x = resize_start_x + resize_start_w - MIN_WINDOW_WIDTH;
             }
+            new_w = MIN_WINDOW_WIDTH;
+        }
+        if (new_h < MIN_WINDOW_HEIGHT) {
             if (resize_edge & RESIZE_TOP) {
-                new_y = resize_start_y + dy;
-                new_h = resize_start_h - dy;
-            }
-            if (resize_edge & RESIZE_BOTTOM) {
-                new_h = resize_start_h + dy;
+                new_y = resize_start_y + resize_start_h - MIN_WINDOW_HEIGHT;
             }
+            new_h = MIN_WINDOW_HEIGHT;
+        }
 
-            /* Enforce minimum size */
-            if (new_w < MIN_WINDOW_WIDTH) {
-                if (resize_edge & RESIZE_LEFT) {
-                    new_x = resize_start_x + resize_start_w - MIN_WINDOW_WIDTH;
-                }
-                new_w = MIN_WINDOW_WIDTH;
+        /* Keep on screen */
+        if (new_x < 0) new_x = 0;
+        if (new_y < 0) new_y = 0;
+
+        resizing_window->x = new_x;
+        resizing_window->y = new_y;
+        resizing_window->width = new_w;
+        resizing_window->height = new_h;
+    } else if (resizing_window && !left_pressed) {
+        /* Stop resizing */
+        resizing_window = 0;
+        resize_edge = RESIZE_NONE;
+    }
+    /* Handle dragging */
+    else if (dragging_window && left_pressed) {
+        /* Continue dragging - update window position */
+        dragging_window->x = mx - drag_offset_x;
+        dragging_window->y = my - drag_offset_y;
+
+        /* Keep window on screen */
+        if (dragging_window->x < 0) dragging_window->x = 0;
+        if (dragging_window->y < 0) dragging_window->y = 0;
+        int max_x = graphics_get_width() - dragging_window->width;
+        int max_y = graphics_get_height() - TASKBAR_HEIGHT - dragging_window->height;
+        if (dragging_window->x > max_x) dragging_window->x = max_x;
+        if (dragging_window->y > max_y) dragging_window->y = max_y;
+    } else if (dragging_window && !left_pressed) {
+        /* Stop dragging */
+        dragging_window = 0;
+    } else if (left_pressed && !was_left_pressed) {
+        /* Just clicked - check what was clicked */
+        int taskbar_y = graphics_get_height() - TASKBAR_HEIGHT;
+
+        if (my >= taskbar_y) {
+            /* Click in taskbar */
+            taskbar_handle_click(mx, my);
+        } else {
+            /* Click in desktop/window area */
+            window_t* focused = wm_get_focused();
+
+            /* Check for resize edge first */
+            int edge = get_resize_edge(focused, mx, my);
+            if (focused && edge != RESIZE_NONE) {
+                /* Start resizing */
+                resizing_window = focused;
+                resize_edge = edge;
+                resize_start_mx = mx;
+                resize_start_my = my;
+                resize_start_x = focused->x;
+                resize_start_y = focused->y;
+                resize_start_w = focused->width;
+                resize_start_h = focused->height;
             }
-            if (new_h < MIN_WINDOW_HEIGHT) {
-                if (resize_edge & RESIZE_TOP) {
-                    new_y = resize_start_y + resize_start_h - MIN_WINDOW_HEIGHT;
+            /* Check if clicking on focused window's titlebar to start drag */
+            else if (focused && point_in_titlebar(focused, mx, my)) {
+                dragging_window = focused;
+                drag_offset_x = mx - focused->x;
+                drag_offset_y = my - focused->y;
+            } else {
+                /* Let window manager handle other clicks */
+                wm_handle_mouse(mx, my, buttons);
+
+                /* After handling, check if we should start dragging new focused window */
+                window_t* new_focused = wm_get_focused();
+                if (new_focused && new_focused != focused) {
+                    /* Check for resize on newly focused window */
+                    int new_edge = get_resize_edge(new_focused, mx, my);
+                    if (new_edge != RESIZE_NONE) {
+                        resizing_window = new_focused;
+                        resize_edge = new_edge;
+                        resize_start_mx = mx;
+                        resize_start_my = my;
+                        resize_start_x = new_focused->x;
+                        resize_start_y = new_focused->y;
+                        resize_start_w = new_focused->width;
+                        resize_start_h = new_focused->height;
+                    } else if (point_in_titlebar(new_focused, mx, my)) {
+                        dragging_window = new_focused;
+                        drag_offset_x = mx - new_focused->x;
+                        drag_offset_y = my - new_focused->y;
+                    }
                 }
-                new_h = MIN_WINDOW_HEIGHT;
             }
+        }
+    }
+
+    prev_mouse_buttons = buttons;
+}
+
+/*
+ * Note a handled event for latency measurement if it left something to
+ * draw - the next frame is the first that can show it
+ */
+static void desktop_track_latency(uint64_t irq_tsc, uint64_t dequeue_tsc) {
+    if (wm_needs_redraw() || taskbar_needs_redraw()) {
+        latency_input_handled(irq_tsc, dequeue_tsc);
+    }
+}
 
-            /* Keep on screen */
-            if (new_x < 0) new_x = 0;
-            if (new_y < 0) new_y = 0;
-
-            resizing_window->x = new_x;
-            resizing_window->y = new_y;
-            resizing_window->width = new_w;
-            resizing_window->height = new_h;
-        } else if (resizing_window && !left_pressed) {
-            /* Stop resizing */
-            resizing_window = 0;
-            resize_edge = RESIZE_NONE;
+/*
+ * Handle every queued input event, in order
+ * Each click is seen, however many arrived since the last pass. Runs of
+ * motion are coalesced into their final position, which is all dragging
+ * and resizing need; the run is timed from its first event.
+ */
+static void desktop_handle_input(void) {
+    input_event_t event;
+    input_event_t move;
+    uint64_t move_tsc = 0;
+    uint64_t move_dequeued = 0;
+    int move_pending = 0;
+
+    while (input_pop(&event)) {
+        uint64_t dequeued = clock_cycles();
+
+        if (event.type == INPUT_MOUSE_MOVE) {
+            if (!move_pending) {
+                move_tsc = event.tsc;
+                move_dequeued = dequeued;
+            }
+            move = event;
+            move_pending = 1;
+            continue;
         }
-        /* Handle dragging */
-        else if (dragging_window && left_pressed) {
-            /* Continue dragging - update window position */
-            dragging_window->x = mx - drag_offset_x;
-            dragging_window->y = my - drag_offset_y;
-
-            /* Keep window on screen */
-            if (dragging_window->x < 0) dragging_window->x = 0;
-            if (dragging_window->y < 0) dragging_window->y = 0;
-            int max_x = graphics_get_width() - dragging_window->width;
-            int max_y = graphics_get_height() - TASKBAR_HEIGHT - dragging_window->height;
-            if (dragging_window->x > max_x) dragging_window->x = max_x;
-            if (dragging_window->y > max_y) dragging_window->y = max_y;
-        } else if (dragging_window && !left_pressed) {
-            /* Stop dragging */
-            dragging_window = 0;
-        } else if (left_pressed && !was_left_pressed) {
-            /* Just clicked - check what was clicked */
-            int taskbar_y = graphics_get_height() - TASKBAR_HEIGHT;
-
-            if (my >= taskbar_y) {
-                /* Click in taskbar */
-                taskbar_handle_click(mx, my);
-            } else {
-                /* Click in desktop/window area */
-                window_t* focused = wm_get_focused();
-
-                /* Check for resize edge first */
-                int edge = get_resize_edge(focused, mx, my);
-                if (focused && edge != RESIZE_NONE) {
-                    /* Start resizing */
-                    resizing_window = focused;
-                    resize_edge = edge;
-                    resize_start_mx = mx;
-                    resize_start_my = my;
-                    resize_start_x = focused->x;
-                    resize_start_y = focused->y;
-                    resize_start_w = focused->width;
-                    resize_start_h = focused->height;
-                }
-                /* Check if clicking on focused window's titlebar to start drag */
-                else if (focused && point_in_titlebar(focused, mx, my)) {
-                    dragging_window = focused;
-                    drag_offset_x = mx - focused->x;
-                    drag_offset_y = my - focused->y;
-                } else {
-                    /* Let window manager handle other clicks */
-                    wm_handle_mouse(mx, my, buttons);
-
-                    /* After handling, check if we should start dragging new focused window */
-                    window_t* new_focused = wm_get_focused();
-                    if (new_focused && new_focused != focused) {
-                        /* Check for resize on newly focused window */
-                        int new_edge = get_resize_edge(new_focused, mx, my);
-                        if (new_edge != RESIZE_NONE) {
-                            resizing_window = new_focused;
-                            resize_edge = new_edge;
-                            resize_start_mx = mx;
-                            resize_start_my = my;
-                            resize_start_x = new_focused->x;
-                            resize_start_y = new_focused->y;
-                            resize_start_w = new_focused->width;
-                            resize_start_h = new_focused->height;
-                        } else if (point_in_titlebar(new_focused, mx, my)) {
-                            dragging_window = new_focused;
-                            drag_offset_x = mx - new_focused->x;
-                            drag_offset_y = my - new_focused->y;
-                        }
-                    }
+        if (move_pending) {
+            desktop_handle_mouse(move.x, move.y, move.buttons);
+            desktop_track_latency(move_tsc, move_dequeued);
+            move_pending = 0;
+        }
+
+        switch (event.type) {
+            case INPUT_KEY_DOWN:
+                /* Forward to focused window */
+                if (event.key) {
+                    wm_handle_key((unsigned char)event.key, event.modifiers);
+                    desktop_track_latency(event.tsc, dequeued);
                 }
+                break;
+
+            case INPUT_MOUSE_BUTTON:
+                desktop_handle_mouse(event.x, event.y, event.buttons);
+                desktop_track_latency(event.tsc, dequeued);
+                break;
+
+            case INPUT_MOUSE_WHEEL:
+                wm_handle_wheel(event.x, event.y, event.wheel);
+                desktop_track_latency(event.tsc, dequeued);
+                break;
+
+            default:
+                /* Key releases have no users yet */
+                break;
+        }
+    }
+
+    if (move_pending) {
+        desktop_handle_mouse(move.x, move.y, move.buttons);
+        desktop_track_latency(move_tsc, move_dequeued);
+    }
+}
+
+/*
+ * Block until the next interrupt unless input is already waiting or a
+ * pending frame is due
+ * Interrupts stay off from the checks (and arming the frame deadline)
+ * until the wait, so neither an event nor the deadline can slip in
+ * unnoticed; wakeups from other threads are remembered by the scheduler.
+ * Other threads run meanwhile.
+ */
+static void desktop_idle(uint64_t next_frame) {
+    __asm__ volatile ("cli");
+    int wait = !input_pending();
+    if (wait && (wm_needs_redraw() || taskbar_needs_redraw())) {
+        /* A frame is owed - sleep only until its slot */
+        if (timer_uptime_ms() >= next_frame) {
+            wait = 0;
+        } else {
+            timer_wakeup_at(next_frame);
+        }
+    }
+    if (wait) {
+        thread_wait_interrupt();
+    }
+    __asm__ volatile ("sti");
+}
+
+/*
+ * Set the target frame rate (frames per second)
+ */
+void desktop_set_frame_rate(int fps) {
+    if (fps < 1) fps = 1;
+    if (fps > 1000) fps = 1000;
+    frame_rate = fps;
+    frame_interval_ms = 1000 / fps;
+}
+
+/*
+ * Get the target frame rate
+ */
+int desktop_get_frame_rate(void) {
+    return frame_rate;
+}
+
+/*
+ * Main desktop loop
+ * This function never returns - it continuously:
+ * 1. Handles keyboard and mouse input
+ * 2. Draws a frame if anything changed and a frame interval has passed
+ * 3. Blocks until the next interrupt otherwise
+ * It runs as the main thread and holds the desktop lock while it works.
+ */
+void desktop_run(void) {
+    if (!initialized) {
+        desktop_init();
+    }
+
+    desktop_thread = thread_current();
+    uint64_t next_frame = 0;
+
+    while (1) {
+        int drew = 0;
+        desktop_lock();
+
+        /* Handle all keyboard and mouse input since the last pass */
+        desktop_handle_input();
+
+        /* Render only when something changed, at most once per interval */
+        /* The cursor is an overlay and moves without a frame */
+        if (wm_needs_redraw() || taskbar_needs_redraw()) {
+            uint64_t now = timer_uptime_ms();
+            if (now >= next_frame) {
+                desktop_draw();
+                next_frame = now + frame_interval_ms;
+                drew = 1;
             }
         }
 
-        prev_mouse_buttons = buttons;
+        desktop_unlock();
+        if (drew) {
+            continue;
+        }
 
-        /* Small delay to avoid using 100% CPU */
-        /* In a real OS, this would be replaced with proper scheduling */
-        for (volatile int i = 0; i < 10000; i++);
+        /* Sleep until input, the next frame deadline or the next clock second */
+        desktop_idle(next_frame);
     }
 }
@@ -3,20 +3,167 @@
 /* External reference to graphics info from graphics.c */
 extern graphics_info_t g_graphics;
 
+/*
+ * Primitives clip once against the surface and then fill whole spans
+ * with unchecked wide stores, instead of bounds-checking every pixel.
+ *
+ * Drawing goes to the current target: the screen back buffer by default,
+ * or an off-screen surface set with draw_set_target(). Coordinates are
+ * always screen coordinates; the target origin translates them.
+ */
+
+/* Current render target */
+static surface_t target;
+static int origin_x = 0;
+static int origin_y = 0;
+static int target_is_screen = 1;
+
+/* Clip rectangle in target coordinates, always inside the target */
+static int clip_x1 = 0;
+static int clip_y1 = 0;
+static int clip_x2 = 0;
+static int clip_y2 = 0;
+
+/* Cohen-Sutherland outcodes */
+#define OUT_LEFT   1
+#define OUT_RIGHT  2
+#define OUT_TOP    4
+#define OUT_BOTTOM 8
+
+/*
+ * Address of pixel (x, y) in the current surface (no bounds check)
+ */
+static inline uint32_t* pixel_addr(int x, int y) {
+    return (uint32_t*)((uint8_t*)target.pixels + y * target.pitch) + x;
+}
+
+/*
+ * Report damage in target coordinates (only the screen is presented)
+ */
+static inline void mark_dirty(int x, int y, int width, int height) {
+    if (target_is_screen) {
+        graphics_mark_dirty(x, y, width, height);
+    }
+}
+
+/*
+ * Copy count pixels from src to dst with rep movsd
+ */
+static inline void copy_span(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    __asm__ volatile ("rep movsl"
+                      : "+D"(dst), "+S"(src), "+c"(count)
+                      :
+                      : "memory");
+}
+
+/*
+ * Direct drawing to a surface
+ * origin_x/origin_y is the screen position of the surface's top-left pixel
+ */
+void draw_set_target(const surface_t* surface, int ox, int oy) {
+    target = *surface;
+    origin_x = ox;
+    origin_y = oy;
+    target_is_screen = 0;
+    draw_reset_clip();
+}
+
+/*
+ * Direct drawing back to the screen back buffer
+ */
+void draw_reset_target(void) {
+    target.pixels = g_graphics.framebuffer;
+    target.width = g_graphics.width;
+    target.height = g_graphics.height;
+    target.pitch = g_graphics.pitch;
+    origin_x = 0;
+    origin_y = 0;
+    target_is_screen = 1;
+    draw_reset_clip();
+}
+
+/*
+ * Restrict drawing to a rectangle (screen coordinates)
+ */
+void draw_set_clip(int x, int y, int width, int height) {
+    draw_reset_clip();
+    x -= origin_x;
+    y -= origin_y;
+    if (x > clip_x1) clip_x1 = x;
+    if (y > clip_y1) clip_y1 = y;
+    if (x + width < clip_x2) clip_x2 = x + width;
+    if (y + height < clip_y2) clip_y2 = y + height;
+    if (clip_x2 < clip_x1) clip_x2 = clip_x1;
+    if (clip_y2 < clip_y1) clip_y2 = clip_y1;
+}
+
+/*
+ * Allow drawing anywhere on the target again
+ */
+void draw_reset_clip(void) {
+    clip_x1 = 0;
+    clip_y1 = 0;
+    clip_x2 = target.width;
+    clip_y2 = target.height;
+}
+
+/*
+ * Fill count pixels starting at dst with rep stosd
+ */
+static inline void fill_span(uint32_t* dst, uint32_t count, color_t color) {
+    __asm__ volatile ("rep stosl"
+                      : "+D"(dst), "+c"(count)
+                      : "a"(color)
+                      : "memory");
+}
+
+/*
+ * Translate a rectangle to target coordinates and clip it to the clip rect
+ * Returns 0 if nothing is left to draw
+ */
+static int clip_rect(int* x, int* y, int* width, int* height) {
+    int x1 = *x - origin_x;
+    int y1 = *y - origin_y;
+    int x2 = x1 + *width;
+    int y2 = y1 + *height;
+
+    if (x1 < clip_x1) x1 = clip_x1;
+    if (y1 < clip_y1) y1 = clip_y1;
+    if (x2 > clip_x2) x2 = clip_x2;
+    if (y2 > clip_y2) y2 = clip_y2;
+
+    if (x1 >= x2 || y1 >= y2) {
+        return 0;
+    }
+
+    *x = x1;
+    *y = y1;
+    *width = x2 - x1;
+    *height = y2 - y1;
+    return 1;
+}
+
 void draw_pixel(int x, int y, color_t color) {
-    if (x < 0 || x >= (int)g_graphics.width || y < 0 || y >= (int)g_graphics.height)
+    x -= origin_x;
+    y -= origin_y;
+    if (x < clip_x1 || x >= clip_x2 || y < clip_y1 || y >= clip_y2)
         return;
-    /* pitch is in bytes, we're writing 32-bit pixels */
-    uint32_t* pixel = (uint32_t*)((uint8_t*)g_graphics.framebuffer + y * g_graphics.pitch + x * 4);
-    *pixel = color;
+    *pixel_addr(x, y) = color;
+    mark_dirty(x, y, 1, 1);
 }
 
 void draw_filled_rect(int x, int y, int width, int height, color_t color) {
-    for (int row = y; row < y + height; row++) {
-        for (int col = x; col < x + width; col++) {
-            draw_pixel(col, row, color);
-        }
+    if (!clip_rect(&x, &y, &width, &height)) {
+        return;
     }
+
+    uint8_t* row = (uint8_t*)pixel_addr(x, y);
+    for (int i = 0; i < height; i++) {
+        fill_span((uint32_t*)row, width, color);
+        row += target.pitch;
+    }
+
+    mark_dirty(x, y, width, height);
 }
 
 void draw_rect(int x, int y, int width, int height, color_t color) {
@@ -27,37 +174,234 @@ void draw_rect(int x, int y, int width, int height, color_t color) {
 }
 
 void draw_hline(int x, int y, int width, color_t color) {
-    for (int i = 0; i < width; i++) {
-        draw_pixel(x + i, y, color);
-    }
+    draw_filled_rect(x, y, width, 1, color);
 }
 
 void draw_vline(int x, int y, int height, color_t color) {
+    int width = 1;
+    if (!clip_rect(&x, &y, &width, &height)) {
+        return;
+    }
+
+    uint8_t* p = (uint8_t*)pixel_addr(x, y);
     for (int i = 0; i < height; i++) {
-        draw_pixel(x, y + i, color);
+        *(uint32_t*)p = color;
+        p += target.pitch;
+    }
+
+    mark_dirty(x, y, 1, height);
+}
+
+/*
+ * Compute the Cohen-Sutherland outcode of a point
+ */
+static int outcode(int x, int y, int max_x, int max_y) {
+    int code = 0;
+    if (x < clip_x1) code |= OUT_LEFT;
+    else if (x > max_x) code |= OUT_RIGHT;
+    if (y < clip_y1) code |= OUT_TOP;
+    else if (y > max_y) code |= OUT_BOTTOM;
+    return code;
+}
+
+/*
+ * Clip a line segment (target coordinates) to the clip rect (Cohen-Sutherland)
+ * Returns 0 if the line is entirely outside
+ */
+static int clip_line(int* x1, int* y1, int* x2, int* y2) {
+    int max_x = clip_x2 - 1;
+    int max_y = clip_y2 - 1;
+    if (max_x < clip_x1 || max_y < clip_y1) {
+        return 0;
+    }
+    int code1 = outcode(*x1, *y1, max_x, max_y);
+    int code2 = outcode(*x2, *y2, max_x, max_y);
+
+    while (1) {
+        if (!(code1 | code2)) {
+            return 1;   /* Both inside */
+        }
+        if (code1 & code2) {
+            return 0;   /* Both on the same outside side */
+        }
+
+        /* Move the outside endpoint onto the clip edge */
+        int code = code1 ? code1 : code2;
+        int dx = *x2 - *x1;
+        int dy = *y2 - *y1;
+        int x, y;
+
+        if (code & OUT_BOTTOM) {
+            x = *x1 + dx * (max_y - *y1) / dy;
+            y = max_y;
+        } else if (code & OUT_TOP) {
+            x = *x1 + dx * (clip_y1 - *y1) / dy;
+            y = clip_y1;
+        } else if (code & OUT_RIGHT) {
+            y = *y1 + dy * (max_x - *x1) / dx;
+            x = max_x;
+        } else {
+            y = *y1 + dy * (clip_x1 - *x1) / dx;
+            x = clip_x1;
+        }
+
+        if (code == code1) {
+            *x1 = x;
+            *y1 = y;
+            code1 = outcode(x, y, max_x, max_y);
+        } else {
+            *x2 = x;
+            *y2 = y;
+            code2 = outcode(x, y, max_x, max_y);
+        }
     }
 }
 
 void draw_line(int x1, int y1, int x2, int y2, color_t color) {
-    /* Bresenham's line algorithm */
+    /* Horizontal and vertical lines are spans */
+    if (y1 == y2) {
+        int x = (x1 < x2) ? x1 : x2;
+        int len = (x1 < x2) ? x2 - x1 : x1 - x2;
+        draw_hline(x, y1, len + 1, color);
+        return;
+    }
+    if (x1 == x2) {
+        int y = (y1 < y2) ? y1 : y2;
+        int len = (y1 < y2) ? y2 - y1 : y1 - y2;
+        draw_vline(x1, y, len + 1, color);
+        return;
+    }
+
+    x1 -= origin_x;
+    y1 -= origin_y;
+    x2 -= origin_x;
+    y2 -= origin_y;
+    if (!clip_line(&x1, &y1, &x2, &y2)) {
+        return;
+    }
+
+    /* Damage is the clipped line's bounding box */
+    int min_x = (x1 < x2) ? x1 : x2;
+    int min_y = (y1 < y2) ? y1 : y2;
+    int max_x = (x1 > x2) ? x1 : x2;
+    int max_y = (y1 > y2) ? y1 : y2;
+
+    /* Bresenham's line algorithm - endpoints are on-surface now */
     int dx = x2 - x1;
     int dy = y2 - y1;
     int sx = (dx > 0) ? 1 : -1;
+    int step_y = (dy > 0) ? (int)target.pitch : -(int)target.pitch;
     int sy = (dy > 0) ? 1 : -1;
     dx = (dx < 0) ? -dx : dx;
     dy = (dy < 0) ? -dy : dy;
 
     int err = dx - dy;
+    uint8_t* p = (uint8_t*)pixel_addr(x1, y1);
 
     while (1) {
-        draw_pixel(x1, y1, color);
+        *(uint32_t*)p = color;
         if (x1 == x2 && y1 == y2) break;
         int e2 = 2 * err;
-        if (e2 > -dy) { err -= dy; x1 += sx; }
-        if (e2 < dx) { err += dx; y1 += sy; }
+        if (e2 > -dy) { err -= dy; x1 += sx; p += sx * 4; }
+        if (e2 < dx) { err += dx; y1 += sy; p += step_y; }
+    }
+
+    mark_dirty(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+}
+
+/*
+ * Copy a width x height block of src, starting at (src_x, src_y),
+ * to (x, y) on the current target
+ */
+void draw_blit(int x, int y, const surface_t* src, int src_x, int src_y,
+               int width, int height) {
+    /* Clip the source rectangle to the source surface */
+    if (src_x < 0) { x -= src_x; width += src_x; src_x = 0; }
+    if (src_y < 0) { y -= src_y; height += src_y; src_y = 0; }
+    if (src_x + width > src->width) width = src->width - src_x;
+    if (src_y + height > src->height) height = src->height - src_y;
+
+    /* Clip the destination, shifting the source by the same amount */
+    int dx = x;
+    int dy = y;
+    if (!clip_rect(&dx, &dy, &width, &height)) {
+        return;
+    }
+    src_x += dx - (x - origin_x);
+    src_y += dy - (y - origin_y);
+
+    const uint8_t* s = (const uint8_t*)src->pixels + src_y * src->pitch + src_x * 4;
+    uint8_t* d = (uint8_t*)pixel_addr(dx, dy);
+    for (int i = 0; i < height; i++) {
+        copy_span((uint32_t*)d, (const uint32_t*)s, width);
+        s += src->pitch;
+        d += target.pitch;
+    }
+
+    mark_dirty(dx, dy, width, height);
+}
+
+/*
+ * Store color wherever a bit is set in a 1-bit-per-pixel mask
+ * Each row is one byte, MSB first, so width is at most 8
+ */
+void draw_mask(int x, int y, const uint8_t* rows, int width, int height, color_t color) {
+    int dx = x;
+    int dy = y;
+    int w = width;
+    int h = height;
+    if (!clip_rect(&dx, &dy, &w, &h)) {
+        return;
+    }
+
+    /* Offset of the clipped area inside the mask */
+    int skip_x = dx - (x - origin_x);
+    int skip_y = dy - (y - origin_y);
+
+    uint8_t* row = (uint8_t*)pixel_addr(dx, dy);
+    for (int i = 0; i < h; i++) {
+        uint8_t bits = (uint8_t)(rows[skip_y + i] << skip_x);
+        uint32_t* p = (uint32_t*)row;
+        for (int j = 0; j < w; j++) {
+            if (bits & (0x80 >> j)) {
+                p[j] = color;
+            }
+        }
+        row += target.pitch;
     }
+
+    mark_dirty(dx, dy, w, h);
 }
 
 void clear_screen(color_t color) {
-    draw_filled_rect(0, 0, g_graphics.width, g_graphics.height, color);
+    draw_filled_rect(origin_x, origin_y, target.width, target.height, color);
+}
+
+/*
+ * Fill a rectangle of the screen back buffer
+ * Stateless: ignores the target and clip, and marks no damage, so any
+ * CPU may call it concurrently for disjoint rectangles. The caller keeps
+ * the rectangle on screen.
+ */
+void draw_screen_fill(int x, int y, int width, int height, color_t color) {
+    uint8_t* row = (uint8_t*)g_graphics.framebuffer + y * g_graphics.pitch + x * 4;
+    for (int i = 0; i < height; i++) {
+        fill_span((uint32_t*)row, width, color);
+        row += g_graphics.pitch;
+    }
+}
+
+/*
+ * Copy a block of a surface to the screen back buffer
+ * Stateless like draw_screen_fill(); both rectangles must be in bounds.
+ */
+void draw_screen_blit(int x, int y, const surface_t* src, int src_x, int src_y,
+                      int width, int height) {
+    const uint8_t* s = (const uint8_t*)src->pixels + src_y * src->pitch + src_x * 4;
+    uint8_t* d = (uint8_t*)g_graphics.framebuffer + y * g_graphics.pitch + x * 4;
+    for (int i = 0; i < height; i++) {
+        copy_span((uint32_t*)d, (const uint32_t*)s, width);
+        s += src->pitch;
+        d += g_graphics.pitch;
+    }
 }
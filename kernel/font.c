@@ -201,25 +201,117 @@ static const uint8_t font_data[95][16] = {
 };
 
 /*
- * Draw a single character at the specified position.
+ * Glyph cache
+ * Glyphs are expanded once into 32-bit pixel cells for each (fg, bg)
+ * color pair in use, so drawing a character is 16 row copies instead of
+ * 128 bit tests. Color pairs are evicted least-recently-used.
+ */
+#define GLYPH_COUNT        95
+#define GLYPH_CACHE_PAIRS  8
+
+typedef struct {
+    color_t fg;
+    color_t bg;
+    uint32_t last_used;                 /* LRU stamp, 0 = empty slot */
+    uint8_t expanded[GLYPH_COUNT];      /* Glyph has been expanded */
+    uint32_t pixels[GLYPH_COUNT][FONT_HEIGHT * FONT_WIDTH];
+} glyph_pair_t;
+
+static glyph_pair_t glyph_cache[GLYPH_CACHE_PAIRS];
+static glyph_pair_t* glyph_last = 0;    /* Most recent hit */
+static uint32_t glyph_clock = 0;
+
+/*
+ * Find (or make room for) the cache entry of a color pair
+ */
+static glyph_pair_t* glyph_cache_lookup(color_t fg, color_t bg) {
+    /* Text is usually drawn in long runs of one color pair */
+    if (glyph_last && glyph_last->fg == fg && glyph_last->bg == bg) {
+        glyph_last->last_used = ++glyph_clock;
+        return glyph_last;
+    }
+
+    glyph_pair_t* victim = &glyph_cache[0];
+    for (int i = 0; i < GLYPH_CACHE_PAIRS; i++) {
+        glyph_pair_t* entry = &glyph_cache[i];
+        if (entry->last_used && entry->fg == fg && entry->bg == bg) {
+            entry->last_used = ++glyph_clock;
+            glyph_last = entry;
+            return entry;
+        }
+        if (entry->last_used < victim->last_used) {
+            victim = entry;
+        }
+    }
+
+    /* Miss - recycle the least recently used pair */
+    victim->fg = fg;
+    victim->bg = bg;
+    victim->last_used = ++glyph_clock;
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        victim->expanded[i] = 0;
+    }
+    glyph_last = victim;
+    return victim;
+}
+
+/*
+ * Get the expanded pixel cell of a glyph, expanding it on first use
+ */
+static const uint32_t* glyph_cache_get(glyph_pair_t* entry, int index) {
+    uint32_t* cell = entry->pixels[index];
+
+    if (!entry->expanded[index]) {
+        for (int row = 0; row < FONT_HEIGHT; row++) {
+            uint8_t bits = font_data[index][row];
+            for (int col = 0; col < FONT_WIDTH; col++) {
+                /* Check if bit is set (MSB first) */
+                cell[row * FONT_WIDTH + col] = (bits & (0x80 >> col)) ? entry->fg : entry->bg;
+            }
+        }
+        entry->expanded[index] = 1;
+    }
+
+    return cell;
+}
+
+/*
+ * Map a character to its glyph index
  * Characters outside the printable ASCII range (32-126) are replaced with '?'.
  */
-void font_draw_char(int x, int y, char c, color_t fg, color_t bg) {
-    /* Replace unprintable characters with '?' */
+static int glyph_index(char c) {
     if (c < 32 || c > 126) {
         c = '?';
     }
+    return c - 32;
+}
 
-    int index = c - 32;
+/*
+ * Draw a glyph from a cache entry (or masked if bg is transparent)
+ */
+static void glyph_draw(glyph_pair_t* entry, int x, int y, char c, color_t fg) {
+    int index = glyph_index(c);
 
-    for (int row = 0; row < FONT_HEIGHT; row++) {
-        uint8_t bits = font_data[index][row];
-        for (int col = 0; col < FONT_WIDTH; col++) {
-            /* Check if bit is set (MSB first) */
-            color_t color = (bits & (0x80 >> col)) ? fg : bg;
-            draw_pixel(x + col, y + row, color);
-        }
+    if (!entry) {
+        /* Transparent background: store only the foreground bits */
+        draw_mask(x, y, font_data[index], FONT_WIDTH, FONT_HEIGHT, fg);
+        return;
     }
+
+    surface_t glyph = {
+        (uint32_t*)glyph_cache_get(entry, index),
+        FONT_WIDTH, FONT_HEIGHT, FONT_WIDTH * 4
+    };
+    draw_blit(x, y, &glyph, 0, 0, FONT_WIDTH, FONT_HEIGHT);
+}
+
+/*
+ * Draw a single character at the specified position.
+ * Pass FONT_TRANSPARENT as bg to leave background pixels untouched.
+ */
+void font_draw_char(int x, int y, char c, color_t fg, color_t bg) {
+    glyph_pair_t* entry = (bg == FONT_TRANSPARENT) ? 0 : glyph_cache_lookup(fg, bg);
+    glyph_draw(entry, x, y, c, fg);
 }
 
 /*
@@ -228,6 +320,7 @@ void font_draw_char(int x, int y, char c, color_t fg, color_t bg) {
  */
 void font_draw_string(int x, int y, const char* str, color_t fg, color_t bg) {
     int start_x = x;
+    glyph_pair_t* entry = (bg == FONT_TRANSPARENT) ? 0 : glyph_cache_lookup(fg, bg);
 
     while (*str) {
         if (*str == '\n') {
@@ -239,7 +332,7 @@ void font_draw_string(int x, int y, const char* str, color_t fg, color_t bg) {
         } else if (*str == '\r') {
             x = start_x;
         } else {
-            font_draw_char(x, y, *str, fg, bg);
+            glyph_draw(entry, x, y, *str, fg);
             x += FONT_WIDTH;
         }
         str++;
@@ -1,50 +1,61 @@
 #include "../include/gdt.h"
+#include "../include/string.h"
 
 /* External assembly function to load GDT */
 extern void gdt_flush(uint32_t gdt_ptr);
 
-/* GDT with 3 entries: null, kernel code, kernel data */
-static struct gdt_entry gdt[3];
-static struct gdt_ptr gp;
+/* One GDT and TSS per CPU: null, kernel code, kernel data, TSS, per-CPU */
+static struct gdt_entry gdt[GDT_MAX_CPUS][GDT_ENTRIES];
+static struct gdt_ptr gp[GDT_MAX_CPUS];
+static struct tss_entry tss[GDT_MAX_CPUS];
 
 /*
  * gdt_set_gate - Set up a GDT entry
+ * @table: GDT to modify
  * @num: Index of the GDT entry
  * @base: Base address of the segment
  * @limit: Limit of the segment
  * @access: Access flags
  * @granularity: Granularity flags
  */
-void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity) {
+static void gdt_set_gate(struct gdt_entry* table, int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity) {
     /* Set base address */
-    gdt[num].base_low = (base & 0xFFFF);
-    gdt[num].base_middle = (base >> 16) & 0xFF;
-    gdt[num].base_high = (base >> 24) & 0xFF;
+    table[num].base_low = (base & 0xFFFF);
+    table[num].base_middle = (base >> 16) & 0xFF;
+    table[num].base_high = (base >> 24) & 0xFF;
 
     /* Set limit */
-    gdt[num].limit_low = (limit & 0xFFFF);
-    gdt[num].granularity = (limit >> 16) & 0x0F;
+    table[num].limit_low = (limit & 0xFFFF);
+    table[num].granularity = (limit >> 16) & 0x0F;
 
     /* Set granularity and access flags */
-    gdt[num].granularity |= (granularity & 0xF0);
-    gdt[num].access = access;
+    table[num].granularity |= (granularity & 0xF0);
+    table[num].access = access;
 }
 
 /*
- * gdt_init - Initialize the Global Descriptor Table
+ * gdt_init_cpu - Initialize the calling CPU's Global Descriptor Table
  *
- * Sets up 3 GDT entries:
+ * Sets up 5 GDT entries:
  * - Entry 0: Null descriptor (required by CPU)
  * - Entry 1: Kernel code segment (0x08)
  * - Entry 2: Kernel data segment (0x10)
+ * - Entry 3: Task state segment (0x18)
+ * - Entry 4: Per-CPU data segment (0x20), loaded into GS
+ *
+ * The selectors are the same on every CPU, so code and interrupt stubs
+ * need not care which CPU they run on.
  */
-void gdt_init(void) {
+void gdt_init_cpu(uint32_t cpu, uint32_t percpu_base, uint32_t percpu_size,
+                  uint32_t stack_top) {
+    struct gdt_entry* table = gdt[cpu];
+
     /* Set up GDT pointer */
-    gp.limit = (sizeof(struct gdt_entry) * 3) - 1;
-    gp.base = (uint32_t)&gdt;
+    gp[cpu].limit = (sizeof(struct gdt_entry) * GDT_ENTRIES) - 1;
+    gp[cpu].base = (uint32_t)table;
 
     /* Entry 0: Null descriptor - required by CPU */
-    gdt_set_gate(0, 0, 0, 0, 0);
+    gdt_set_gate(table, 0, 0, 0, 0, 0);
 
     /* Entry 1: Kernel code segment
      * Base: 0x00000000
@@ -64,7 +75,7 @@ void gdt_init(void) {
      *   - AVL (0)
      *   - Limit bits 19:16 (F)
      */
-    gdt_set_gate(1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
+    gdt_set_gate(table, 1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
 
     /* Entry 2: Kernel data segment
      * Base: 0x00000000
@@ -79,8 +90,26 @@ void gdt_init(void) {
      *   - Accessed (0)
      * Granularity: 0xCF (same as code segment)
      */
-    gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xCF);
+    gdt_set_gate(table, 2, 0, 0xFFFFFFFF, 0x92, 0xCF);
+
+    /* Entry 3: TSS
+     * Access: 0x89 - present, ring 0, 32-bit available TSS
+     * Granularity: 0x00 - byte limit
+     */
+    struct tss_entry* t = &tss[cpu];
+    memset(t, 0, sizeof(*t));
+    t->ss0 = KERNEL_DATA_SEG;
+    t->esp0 = stack_top;
+    t->iomap_base = sizeof(*t);     /* No I/O permission bitmap */
+    gdt_set_gate(table, 3, (uint32_t)t, sizeof(*t) - 1, 0x89, 0x00);
+
+    /* Entry 4: Per-CPU data
+     * Access: 0x92 (data, writable), byte granular 32-bit segment
+     */
+    gdt_set_gate(table, 4, percpu_base, percpu_size - 1, 0x92, 0x40);
 
-    /* Load the GDT */
-    gdt_flush((uint32_t)&gp);
+    /* Load the GDT, then the task register and GS */
+    gdt_flush((uint32_t)&gp[cpu]);
+    __asm__ volatile ("ltr %w0" : : "r"(KERNEL_TSS_SEG));
+    __asm__ volatile ("mov %w0, %%gs" : : "r"(PERCPU_SEG));
 }
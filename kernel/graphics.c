@@ -4,6 +4,11 @@
  */
 
 #include "graphics.h"
+#include "cpu.h"
+#include "cursor.h"
+#include "heap.h"
+#include "bga.h"
+#include "clock.h"
 
 /* Multiboot info flag for framebuffer info valid (bit 12) */
 #define MULTIBOOT_FLAG_FRAMEBUFFER (1 << 12)
@@ -24,9 +29,120 @@ graphics_info_t g_graphics = {
 };
 
 /* Double buffer for flicker-free rendering */
-/* Allocate 800x600x4 bytes = 1920000 bytes (~1.8MB) */
-static uint32_t back_buffer[800 * 600];
+/* Allocated from the heap to fit the mode; unused while page flipping */
+static uint32_t* back_buffer = 0;
+static uint32_t back_buffer_capacity = 0;  /* Pixels */
 static uint32_t* front_buffer = 0;
+static uint32_t front_pitch = 0;     /* Real framebuffer bytes per row */
+
+/* Page flipping (BGA only) - two pages stacked in a double-height screen */
+static uint32_t* vram_base = 0;
+static uint32_t* pages[2];
+static int front_page = 0;           /* Page the adapter is showing */
+static int flip_enabled = 0;
+
+/* Row copy kernels used by the present path */
+typedef void (*blit_row_fn)(uint32_t* dst, const uint32_t* src, uint32_t count);
+
+static void blit_row_c(uint32_t* dst, const uint32_t* src, uint32_t count);
+static void blit_row_movsd(uint32_t* dst, const uint32_t* src, uint32_t count);
+static void blit_row_sse2(uint32_t* dst, const uint32_t* src, uint32_t count);
+
+typedef struct {
+    const char* name;
+    blit_row_fn fn;
+} blitter_t;
+
+static const blitter_t blitters[GRAPHICS_BLITTER_COUNT] = {
+    [GRAPHICS_BLITTER_C]     = { "c",     blit_row_c },
+    [GRAPHICS_BLITTER_MOVSD] = { "movsd", blit_row_movsd },
+    [GRAPHICS_BLITTER_SSE2]  = { "sse2",  blit_row_sse2 },
+};
+
+static int current_blitter = GRAPHICS_BLITTER_C;
+
+/* Damage tracking - rectangles of the back buffer changed since last present */
+/* Rectangles are stored as half-open [x1, x2) x [y1, y2) spans */
+#define MAX_DIRTY_RECTS   32
+#define DIRTY_MERGE_SLACK 4096  /* Extra pixels we accept copying to save a rect */
+
+typedef struct {
+    int x1, y1;
+    int x2, y2;
+} dirty_rect_t;
+
+static dirty_rect_t dirty_rects[MAX_DIRTY_RECTS];
+static int dirty_count = 0;
+
+/*
+ * Make sure the back buffer can hold a width x height frame
+ * Only grows; a smaller mode reuses the existing allocation.
+ * Returns 0 on success, -1 if out of memory
+ */
+static int back_buffer_reserve(uint32_t width, uint32_t height) {
+    uint32_t pixels = width * height;
+    if (pixels <= back_buffer_capacity) {
+        return 0;
+    }
+
+    uint32_t* buffer = (uint32_t*)kmalloc(pixels * 4);
+    if (!buffer) {
+        return -1;
+    }
+    if (back_buffer) {
+        kfree(back_buffer);
+    }
+    back_buffer = buffer;
+    back_buffer_capacity = pixels;
+    return 0;
+}
+
+/*
+ * Set up presentation for a width x height mode
+ * Prefers page flipping: the adapter shows one half of a double-height
+ * virtual screen while we draw straight into the other, and a present just
+ * moves the Y offset. Falls back to a heap back buffer copied to the screen.
+ * Returns 0 on success, -1 if out of memory
+ */
+static int graphics_configure(uint32_t width, uint32_t height) {
+    front_buffer = vram_base;
+    front_page = 0;
+    flip_enabled = 0;
+
+    if (bga_is_available() && front_pitch == width * 4 &&
+        bga_set_virtual_height(height * 2) == 0) {
+        bga_set_y_offset(0);
+        pages[0] = vram_base;
+        pages[1] = vram_base + width * height;
+        flip_enabled = 1;
+
+        /* No RAM copy of the screen needed any more */
+        if (back_buffer) {
+            kfree(back_buffer);
+            back_buffer = 0;
+            back_buffer_capacity = 0;
+        }
+        g_graphics.framebuffer = pages[1];  /* Draw to hidden page */
+    } else {
+        if (back_buffer_reserve(width, height) != 0) {
+            return -1;
+        }
+        g_graphics.framebuffer = back_buffer;  /* Draw to back buffer */
+    }
+
+    g_graphics.width = width;
+    g_graphics.height = height;
+    g_graphics.pitch = width * 4;  /* Both back buffer kinds are tightly packed */
+    g_graphics.bpp = 32;
+
+    /* Drawing starts out targeting the back buffer */
+    draw_reset_target();
+
+    /* First present must copy the whole screen */
+    dirty_count = 0;
+    graphics_mark_dirty(0, 0, width, height);
+    return 0;
+}
 
 /*
  * Initialize graphics from multiboot info
@@ -82,14 +198,88 @@ void graphics_init(void* multiboot_info) {
         return;
     }
 
+    /* Everything draws 32-bit pixels - ask the adapter for that if needed */
+    if (fb_bpp != 32) {
+        if (bga_set_mode(fb_width, fb_height, 32) != 0) {
+            return;
+        }
+        fb_pitch = fb_width * 4;
+    }
+
     /* Store framebuffer info */
-    front_buffer = (uint32_t*)(uintptr_t)fb_addr_low;
-    g_graphics.framebuffer = back_buffer;  /* Draw to back buffer */
-    g_graphics.width = fb_width;
-    g_graphics.height = fb_height;
-    g_graphics.pitch = fb_width * 4;  /* Back buffer is tightly packed */
-    g_graphics.bpp = fb_bpp;
+    vram_base = (uint32_t*)(uintptr_t)fb_addr_low;
+    front_pitch = fb_pitch;
     g_graphics.initialized = 1;
+
+    /* Pick the fastest row copy this CPU supports */
+    if (graphics_blitter_available(GRAPHICS_BLITTER_SSE2)) {
+        current_blitter = GRAPHICS_BLITTER_SSE2;
+    } else {
+        current_blitter = GRAPHICS_BLITTER_MOVSD;
+    }
+
+    /* Flip pages or size a back buffer for the mode GRUB actually gave us */
+    if (graphics_configure(fb_width, fb_height) != 0) {
+        g_graphics.initialized = 0;
+    }
+}
+
+/*
+ * Check if the resolution can be changed at runtime
+ */
+int graphics_can_set_mode(void) {
+    return g_graphics.initialized && bga_is_available();
+}
+
+/*
+ * Switch the display to width x height, 32 bpp
+ * Needs a BGA-compatible adapter. The back buffer is resized and the whole
+ * screen is marked dirty; callers repaint everything before the next swap.
+ * Returns 0 on success, -1 if the mode is unsupported or memory ran out
+ */
+int graphics_set_mode(uint32_t width, uint32_t height) {
+    if (!graphics_can_set_mode() || width == 0 || height == 0) {
+        return -1;
+    }
+
+    /* Without flipping we need room for a back buffer before going ahead */
+    uint32_t vram = bga_get_vram_size();
+    if ((vram == 0 || vram < width * height * 8) &&
+        back_buffer_reserve(width, height) != 0) {
+        return -1;
+    }
+
+    /* The mode switch wipes the front buffer - take the cursor off first */
+    cursor_present_begin();
+    cursor_present_rect(0, 0, g_graphics.width, g_graphics.height);
+
+    int result = -1;
+    if (bga_set_mode(width, height, 32) == 0) {
+        front_pitch = width * 4;
+        result = graphics_configure(width, height);
+    }
+
+    if (result != 0) {
+        /* Put the old mode back; its contents are repainted on next swap */
+        uint32_t old_width = g_graphics.width;
+        uint32_t old_height = g_graphics.height;
+        bga_set_mode(old_width, old_height, 32);
+        front_pitch = old_width * 4;
+        graphics_configure(old_width, old_height);
+    }
+
+    cursor_present_end();
+    return result;
+}
+
+/*
+ * How many presents old the back buffer contents are
+ * 1 when copying (the back buffer already holds the last frame), 2 when
+ * page flipping (the hidden page holds the frame before that). Callers
+ * must repaint the damage of that many frames, including this one.
+ */
+int graphics_buffer_age(void) {
+    return flip_enabled ? 2 : 1;
 }
 
 /*
@@ -115,7 +305,237 @@ uint32_t graphics_get_height(void) {
 }
 
 /*
- * Swap buffers - copy back buffer to front buffer
+ * Area of a dirty rectangle in pixels
+ */
+static int dirty_area(const dirty_rect_t* r) {
+    return (r->x2 - r->x1) * (r->y2 - r->y1);
+}
+
+/*
+ * Mark a rectangle of the back buffer as changed
+ * The next graphics_swap_buffers() copies it to the screen.
+ * Overlapping or nearby rectangles are merged so the list stays short.
+ */
+void graphics_mark_dirty(int x, int y, int width, int height) {
+    if (!g_graphics.initialized) {
+        return;
+    }
+
+    /* Clip to the screen */
+    dirty_rect_t r = { x, y, x + width, y + height };
+    if (r.x1 < 0) r.x1 = 0;
+    if (r.y1 < 0) r.y1 = 0;
+    if (r.x2 > (int)g_graphics.width) r.x2 = g_graphics.width;
+    if (r.y2 > (int)g_graphics.height) r.y2 = g_graphics.height;
+    if (r.x1 >= r.x2 || r.y1 >= r.y2) {
+        return;
+    }
+
+    /* Already covered - nothing to do (common for per-pixel drawing) */
+    for (int i = 0; i < dirty_count; i++) {
+        dirty_rect_t* d = &dirty_rects[i];
+        if (r.x1 >= d->x1 && r.x2 <= d->x2 && r.y1 >= d->y1 && r.y2 <= d->y2) {
+            return;
+        }
+    }
+
+    /* Absorb every rect whose union with ours wastes little area */
+    int i = 0;
+    while (i < dirty_count) {
+        dirty_rect_t* d = &dirty_rects[i];
+        dirty_rect_t u = {
+            d->x1 < r.x1 ? d->x1 : r.x1,
+            d->y1 < r.y1 ? d->y1 : r.y1,
+            d->x2 > r.x2 ? d->x2 : r.x2,
+            d->y2 > r.y2 ? d->y2 : r.y2
+        };
+
+        if (dirty_area(&u) <= dirty_area(d) + dirty_area(&r) + DIRTY_MERGE_SLACK) {
+            /* Merge, drop the old rect and rescan since the union grew */
+            r = u;
+            dirty_rects[i] = dirty_rects[--dirty_count];
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    /* List full - fold into the rect whose union grows the least */
+    if (dirty_count == MAX_DIRTY_RECTS) {
+        int best = 0;
+        int best_cost = 0x7FFFFFFF;
+        for (i = 0; i < dirty_count; i++) {
+            dirty_rect_t* d = &dirty_rects[i];
+            dirty_rect_t u = {
+                d->x1 < r.x1 ? d->x1 : r.x1,
+                d->y1 < r.y1 ? d->y1 : r.y1,
+                d->x2 > r.x2 ? d->x2 : r.x2,
+                d->y2 > r.y2 ? d->y2 : r.y2
+            };
+            int cost = dirty_area(&u) - dirty_area(d);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = i;
+            }
+        }
+        dirty_rect_t* d = &dirty_rects[best];
+        if (r.x1 < d->x1) d->x1 = r.x1;
+        if (r.y1 < d->y1) d->y1 = r.y1;
+        if (r.x2 > d->x2) d->x2 = r.x2;
+        if (r.y2 > d->y2) d->y2 = r.y2;
+        return;
+    }
+
+    dirty_rects[dirty_count++] = r;
+}
+
+/*
+ * Plain C row copy - one 32-bit store per pixel
+ */
+static void blit_row_c(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+/*
+ * String-instruction row copy (rep movsd)
+ */
+static void blit_row_movsd(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    __asm__ volatile ("rep movsl"
+                      : "+D"(dst), "+S"(src), "+c"(count)
+                      :
+                      : "memory");
+}
+
+/*
+ * SSE2 row copy with non-temporal stores
+ * Streaming stores bypass the cache so presenting a frame does not evict
+ * the back buffer and everything else we are working on.
+ */
+__attribute__((target("sse2")))
+static void blit_row_sse2(uint32_t* dst, const uint32_t* src, uint32_t count) {
+    /* Head: single pixels until dst is 16-byte aligned */
+    while (count > 0 && ((uintptr_t)dst & 15)) {
+        __asm__ volatile ("movnti %1, %0" : "=m"(*dst) : "r"(*src));
+        dst++;
+        src++;
+        count--;
+    }
+
+    /* Body: 64 bytes (16 pixels) per iteration */
+    while (count >= 16) {
+        __asm__ volatile (
+            "movdqu   0(%1), %%xmm0\n"
+            "movdqu  16(%1), %%xmm1\n"
+            "movdqu  32(%1), %%xmm2\n"
+            "movdqu  48(%1), %%xmm3\n"
+            "movntdq %%xmm0,  0(%0)\n"
+            "movntdq %%xmm1, 16(%0)\n"
+            "movntdq %%xmm2, 32(%0)\n"
+            "movntdq %%xmm3, 48(%0)\n"
+            :
+            : "r"(dst), "r"(src)
+            : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+        dst += 16;
+        src += 16;
+        count -= 16;
+    }
+
+    /* Tail */
+    while (count > 0) {
+        __asm__ volatile ("movnti %1, %0" : "=m"(*dst) : "r"(*src));
+        dst++;
+        src++;
+        count--;
+    }
+
+    /* Make the weakly-ordered stores globally visible */
+    __asm__ volatile ("sfence" : : : "memory");
+}
+
+/*
+ * Check whether a blitter can run on this CPU
+ */
+int graphics_blitter_available(int blitter) {
+    switch (blitter) {
+        case GRAPHICS_BLITTER_C:
+        case GRAPHICS_BLITTER_MOVSD:
+            return 1;
+        case GRAPHICS_BLITTER_SSE2:
+            return g_cpu.sse_enabled && cpu_has_feature_edx(CPUID_EDX_SSE2);
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Get the short name of a blitter ("c", "movsd", "sse2")
+ */
+const char* graphics_blitter_name(int blitter) {
+    if (blitter < 0 || blitter >= GRAPHICS_BLITTER_COUNT) {
+        return "?";
+    }
+    return blitters[blitter].name;
+}
+
+/*
+ * Get the blitter used by graphics_swap_buffers()
+ */
+int graphics_get_blitter(void) {
+    return current_blitter;
+}
+
+/*
+ * Select the blitter used by graphics_swap_buffers()
+ * Returns 0 on success, -1 if the CPU cannot run it
+ */
+int graphics_set_blitter(int blitter) {
+    if (!graphics_blitter_available(blitter)) {
+        return -1;
+    }
+    current_blitter = blitter;
+    return 0;
+}
+
+/*
+ * Copy one rectangle of the back buffer to the front buffer
+ */
+static void present_rect(blit_row_fn blit, int x1, int y1, int x2, int y2) {
+    uint32_t count = x2 - x1;
+    const uint32_t* src = back_buffer + y1 * g_graphics.width + x1;
+    uint8_t* dst = (uint8_t*)front_buffer + y1 * front_pitch + x1 * 4;
+
+    for (int y = y1; y < y2; y++) {
+        blit((uint32_t*)dst, src, count);
+        src += g_graphics.width;
+        dst += front_pitch;
+    }
+}
+
+/*
+ * Show the hidden page and start drawing into the one that was on screen
+ */
+static void present_flip(void) {
+    int back = front_page ^ 1;
+
+    /* The sprite must not stay behind in the page we draw into next */
+    cursor_present_begin();
+    cursor_present_rect(0, 0, g_graphics.width, g_graphics.height);
+
+    bga_set_y_offset(back * g_graphics.height);
+    front_page = back;
+    front_buffer = pages[back];
+    g_graphics.framebuffer = pages[back ^ 1];
+    draw_reset_target();
+
+    cursor_present_end();
+}
+
+/*
+ * Swap buffers - put the finished frame on screen
+ * Flips pages when the adapter supports it, otherwise copies the dirty
+ * parts of the back buffer to the front buffer.
  * This is called once per frame after all drawing is complete
  */
 void graphics_swap_buffers(void) {
@@ -123,12 +543,108 @@ void graphics_swap_buffers(void) {
         return;
     }
 
-    /* Copy back buffer to front buffer */
-    uint32_t* src = back_buffer;
-    uint32_t* dst = front_buffer;
-    uint32_t pixels = g_graphics.width * g_graphics.height;
+    if (dirty_count == 0) {
+        return;
+    }
 
-    for (uint32_t i = 0; i < pixels; i++) {
-        dst[i] = src[i];
+    if (flip_enabled) {
+        present_flip();
+        dirty_count = 0;
+        return;
+    }
+
+    /* Copy only the rectangles that changed since the last present */
+    /* The cursor overlay steps aside wherever we overwrite it */
+    blit_row_fn blit = blitters[current_blitter].fn;
+
+    cursor_present_begin();
+    for (int i = 0; i < dirty_count; i++) {
+        dirty_rect_t* r = &dirty_rects[i];
+        cursor_present_rect(r->x1, r->y1, r->x2, r->y2);
+        present_rect(blit, r->x1, r->y1, r->x2, r->y2);
+    }
+    cursor_present_end();
+
+    dirty_count = 0;
+}
+
+/*
+ * Read a block of pixels straight from the front buffer
+ * Used by overlays that draw over the presented image; no clipping.
+ */
+void graphics_front_read(int x, int y, int width, int height,
+                         uint32_t* dst, int dst_stride) {
+    if (!front_buffer) return;
+
+    const uint8_t* row = (const uint8_t*)front_buffer + y * front_pitch + x * 4;
+    for (int i = 0; i < height; i++) {
+        const uint32_t* src = (const uint32_t*)row;
+        for (int j = 0; j < width; j++) {
+            dst[j] = src[j];
+        }
+        dst += dst_stride;
+        row += front_pitch;
+    }
+}
+
+/*
+ * Write a block of pixels straight to the front buffer
+ */
+void graphics_front_write(int x, int y, int width, int height,
+                          const uint32_t* src, int src_stride) {
+    if (!front_buffer) return;
+
+    uint8_t* row = (uint8_t*)front_buffer + y * front_pitch + x * 4;
+    for (int i = 0; i < height; i++) {
+        uint32_t* dst = (uint32_t*)row;
+        for (int j = 0; j < width; j++) {
+            dst[j] = src[j];
+        }
+        src += src_stride;
+        row += front_pitch;
+    }
+}
+
+/* Length of each blitter benchmark run */
+#define BENCH_WINDOW_MS   50
+
+/*
+ * Measure present throughput of a blitter
+ * Copies full frames (row by row, real pitch) for a fixed time window.
+ * When page flipping there is no RAM back buffer, so the hidden page is
+ * copied onto itself instead (VRAM to VRAM, nothing visible changes).
+ * Returns MB/s (10^6 bytes per second), or 0 if unavailable
+ */
+uint32_t graphics_benchmark_blitter(int blitter) {
+    if (!g_graphics.initialized || !front_buffer ||
+        !graphics_blitter_available(blitter)) {
+        return 0;
+    }
+
+    blit_row_fn blit = blitters[blitter].fn;
+    uint32_t row_bytes = g_graphics.width * 4;
+    uint32_t rows = 0;
+    uint32_t y = 0;
+
+    uint8_t* dst = flip_enabled ? (uint8_t*)g_graphics.framebuffer : (uint8_t*)front_buffer;
+    uint32_t dst_pitch = flip_enabled ? g_graphics.pitch : front_pitch;
+
+    /* The benchmark rewrites the whole screen */
+    cursor_present_begin();
+    cursor_present_rect(0, 0, g_graphics.width, g_graphics.height);
+
+    uint64_t end = clock_now_ns() + (uint64_t)BENCH_WINDOW_MS * 1000000;
+    while (clock_now_ns() < end) {
+        blit((uint32_t*)(dst + y * dst_pitch),
+             g_graphics.framebuffer + y * g_graphics.width, g_graphics.width);
+        rows++;
+        if (++y == g_graphics.height) {
+            y = 0;
+        }
     }
+
+    cursor_present_end();
+
+    /* bytes per window_ms * 1000 = MB/s */
+    return (rows * row_bytes) / (BENCH_WINDOW_MS * 1000);
 }
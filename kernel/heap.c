@@ -0,0 +1,208 @@
+/*
+ * AJOS Kernel Heap
+ * First-fit allocator over a linked list of blocks with coalescing on free
+ */
+
+#include "../include/heap.h"
+#include "../include/spinlock.h"
+#include "../include/string.h"
+
+/* Multiboot info flags */
+#define MULTIBOOT_FLAG_MEM     (1 << 0)     /* mem_lower/mem_upper valid */
+#define MULTIBOOT_FLAG_CMDLINE (1 << 2)
+#define MULTIBOOT_FLAG_MODS    (1 << 3)
+#define MULTIBOOT_FLAG_MMAP    (1 << 6)
+#define MULTIBOOT_FLAG_LOADER  (1 << 9)     /* boot_loader_name valid */
+
+/* Bytes of the multiboot info structure itself, up to the framebuffer fields */
+#define MULTIBOOT_INFO_SIZE    116
+#define MULTIBOOT_MODULE_SIZE  16
+
+/* Used when the bootloader gives no memory info */
+#define HEAP_DEFAULT_SIZE (16 * 1024 * 1024)
+
+/* Minimum leftover worth splitting off as a separate free block */
+#define HEAP_MIN_SPLIT 64
+
+#define HEAP_ALIGN 16
+
+/* Block header - sits right before every allocation */
+typedef struct heap_block {
+    size_t size;                /* Payload bytes (excluding header) */
+    int free;
+    struct heap_block* next;    /* Next block in address order */
+    uint32_t pad;               /* Keep payload 16-byte aligned */
+} heap_block_t;
+
+/* End of kernel image - defined in linker.ld */
+extern uint8_t __kernel_end[];
+
+static heap_block_t* heap_head = 0;
+
+/* Serializes the block list between CPUs (and interrupt handlers) */
+static spinlock_t heap_lock = SPINLOCK_INIT;
+
+/*
+ * Round up to the heap alignment
+ */
+static uintptr_t align_up(uintptr_t value) {
+    return (value + HEAP_ALIGN - 1) & ~(uintptr_t)(HEAP_ALIGN - 1);
+}
+
+/*
+ * Move the heap start past a boot data range that lies above it
+ * Data below the kernel end (usually all of it, in low memory) is left
+ * alone. Called for every range, in any order, this leaves the start
+ * above all of them.
+ */
+static void heap_skip(uintptr_t* start, uintptr_t end, uintptr_t addr, uintptr_t len) {
+    if (addr < end && addr + len > *start) {
+        *start = addr + len;
+    }
+}
+
+/*
+ * Initialize the heap
+ * The heap begins after the kernel image and after any multiboot data
+ * GRUB placed there (info structure, command line, modules, memory map),
+ * which is still read after this - by graphics_init() among others.
+ *
+ * Multiboot info structure offsets:
+ *   0: flags (uint32_t)
+ *   8: mem_upper (uint32_t) - KB of memory above 1MB
+ *   16: cmdline (char*)
+ *   20: mods_count (uint32_t), 24: mods_addr
+ *   44: mmap_length (uint32_t), 48: mmap_addr
+ *   64: boot_loader_name (char*)
+ */
+void heap_init(void* multiboot_info) {
+    uintptr_t start = (uintptr_t)__kernel_end;
+    uintptr_t end = align_up(start) + HEAP_DEFAULT_SIZE;
+
+    if (multiboot_info) {
+        uint8_t* mb_info = (uint8_t*)multiboot_info;
+        uint32_t flags = *((uint32_t*)(mb_info + 0));
+        if (flags & MULTIBOOT_FLAG_MEM) {
+            uint32_t mem_upper = *((uint32_t*)(mb_info + 8));
+            end = 0x100000 + (uintptr_t)mem_upper * 1024;
+        }
+
+        heap_skip(&start, end, (uintptr_t)mb_info, MULTIBOOT_INFO_SIZE);
+        if (flags & MULTIBOOT_FLAG_CMDLINE) {
+            const char* cmdline = *((const char**)(mb_info + 16));
+            heap_skip(&start, end, (uintptr_t)cmdline, strlen(cmdline) + 1);
+        }
+        if (flags & MULTIBOOT_FLAG_MODS) {
+            uint32_t count = *((uint32_t*)(mb_info + 20));
+            uint32_t* mods = *((uint32_t**)(mb_info + 24));
+            heap_skip(&start, end, (uintptr_t)mods, count * MULTIBOOT_MODULE_SIZE);
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t* mod = mods + i * (MULTIBOOT_MODULE_SIZE / 4);
+                heap_skip(&start, end, mod[0], mod[1] - mod[0]);
+                if (mod[2]) {
+                    heap_skip(&start, end, mod[2], strlen((const char*)mod[2]) + 1);
+                }
+            }
+        }
+        if (flags & MULTIBOOT_FLAG_MMAP) {
+            heap_skip(&start, end, *((uint32_t*)(mb_info + 48)),
+                      *((uint32_t*)(mb_info + 44)));
+        }
+        if (flags & MULTIBOOT_FLAG_LOADER) {
+            const char* name = *((const char**)(mb_info + 64));
+            heap_skip(&start, end, (uintptr_t)name, strlen(name) + 1);
+        }
+    }
+    start = align_up(start);
+
+    if (end <= start + sizeof(heap_block_t) + HEAP_MIN_SPLIT) {
+        heap_head = 0;
+        return;
+    }
+
+    heap_head = (heap_block_t*)start;
+    heap_head->size = (end - start - sizeof(heap_block_t)) & ~(size_t)(HEAP_ALIGN - 1);
+    heap_head->free = 1;
+    heap_head->next = 0;
+}
+
+/*
+ * Allocate memory from the heap
+ */
+void* kmalloc(size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    size = align_up(size);
+
+    void* result = 0;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+
+    for (heap_block_t* block = heap_head; block; block = block->next) {
+        if (!block->free || block->size < size) {
+            continue;
+        }
+
+        /* Split off the remainder if it is big enough to be useful */
+        if (block->size >= size + sizeof(heap_block_t) + HEAP_MIN_SPLIT) {
+            heap_block_t* rest = (heap_block_t*)((uint8_t*)(block + 1) + size);
+            rest->size = block->size - size - sizeof(heap_block_t);
+            rest->free = 1;
+            rest->next = block->next;
+            block->next = rest;
+            block->size = size;
+        }
+
+        block->free = 0;
+        result = block + 1;
+        break;
+    }
+
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return result;  /* 0 if out of memory */
+}
+
+/*
+ * Free memory and merge with free neighbours
+ */
+void kfree(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    heap_block_t* block = (heap_block_t*)ptr - 1;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    block->free = 1;
+
+    /* Merge with the following block(s) */
+    while (block->next && block->next->free) {
+        block->size += sizeof(heap_block_t) + block->next->size;
+        block->next = block->next->next;
+    }
+
+    /* Merge with the preceding block */
+    for (heap_block_t* prev = heap_head; prev && prev != block; prev = prev->next) {
+        if (prev->next == block && prev->free) {
+            prev->size += sizeof(heap_block_t) + block->size;
+            prev->next = block->next;
+            break;
+        }
+    }
+
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+/*
+ * Get the number of free bytes in the heap
+ */
+size_t heap_free_bytes(void) {
+    size_t total = 0;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    for (heap_block_t* block = heap_head; block; block = block->next) {
+        if (block->free) {
+            total += block->size;
+        }
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return total;
+}
@@ -0,0 +1,458 @@
+/*
+ * AJOS i8042 PS/2 Controller
+ * Bounded controller setup, interrupt-driven asynchronous device commands
+ */
+
+#include "i8042.h"
+#include "byte_ring.h"
+#include "clock.h"
+#include "cpu.h"
+#include "io.h"
+#include "irq.h"
+#include "softirq.h"
+#include "timer.h"
+
+#define I8042_DATA          0x60
+#define I8042_STATUS        0x64    /* Read */
+#define I8042_COMMAND       0x64    /* Write */
+
+/* Status register */
+#define STATUS_OUTPUT_FULL  0x01
+#define STATUS_INPUT_FULL   0x02
+#define STATUS_AUX_DATA     0x20    /* Output byte came from the aux port */
+
+/* Controller commands */
+#define CTRL_READ_CONFIG    0x20
+#define CTRL_WRITE_CONFIG   0x60
+#define CTRL_DISABLE_AUX    0xA7
+#define CTRL_ENABLE_AUX     0xA8
+#define CTRL_TEST_AUX       0xA9
+#define CTRL_SELF_TEST      0xAA
+#define CTRL_TEST_KEYBOARD  0xAB
+#define CTRL_DISABLE_KBD    0xAD
+#define CTRL_ENABLE_KBD     0xAE
+#define CTRL_WRITE_AUX      0xD4
+
+/* Configuration byte */
+#define CONFIG_KBD_IRQ      0x01
+#define CONFIG_AUX_IRQ      0x02
+#define CONFIG_AUX_DISABLED 0x20
+
+#define SELF_TEST_PASSED    0x55
+#define PORT_TEST_PASSED    0x00
+
+/* Device replies */
+#define DEV_ACK             0xFA
+#define DEV_RESEND          0xFE
+#define DEV_ERROR           0xFC
+
+#define POLL_STEP_US        10
+#define FLUSH_LIMIT         32
+
+typedef struct {
+    uint8_t bytes[I8042_MAX_CMD];
+    uint8_t len;
+    uint8_t reply_len;
+    uint32_t timeout_ms;
+    i8042_done_t done;
+    void* ctx;
+} command_t;
+
+typedef struct {
+    int present;
+    i8042_receive_t receive;
+    i8042_drained_t drained;
+    byte_ring_t ring;               /* Raw bytes from the top half */
+
+    /* Command queue; the head is in flight while busy is set */
+    command_t queue[I8042_QUEUE_SIZE];
+    int head;
+    int count;
+    int busy;
+    int sent;                       /* Bytes of the head command ACKed */
+    int resends;
+    int received;                   /* Reply bytes collected */
+    uint8_t reply[I8042_MAX_REPLY];
+    uint64_t written_tsc;           /* When the byte awaiting an ACK was written */
+    uint64_t deadline_ms;
+} port_t;
+
+static port_t ports[I8042_PORTS];
+static uint8_t irq_lines[I8042_PORTS] = { 1, 12 };
+
+/*
+ * Poll the status register until (status & mask) == want, for at most
+ * timeout_us. Returns 0 on success, -1 on timeout.
+ */
+static int i8042_wait(uint8_t mask, uint8_t want, uint32_t timeout_us) {
+    for (uint32_t waited = 0; ; waited += POLL_STEP_US) {
+        if ((inb(I8042_STATUS) & mask) == want) {
+            return 0;
+        }
+        if (waited >= timeout_us) {
+            return -1;
+        }
+        clock_delay_us(POLL_STEP_US);
+    }
+}
+
+/*
+ * Send a controller command (and an optional data byte)
+ */
+static int i8042_ctrl(uint8_t command) {
+    if (i8042_wait(STATUS_INPUT_FULL, 0, I8042_CTRL_TIMEOUT_US) != 0) return -1;
+    outb(I8042_COMMAND, command);
+    return 0;
+}
+
+static int i8042_ctrl_write(uint8_t command, uint8_t data) {
+    if (i8042_ctrl(command) != 0) return -1;
+    if (i8042_wait(STATUS_INPUT_FULL, 0, I8042_CTRL_TIMEOUT_US) != 0) return -1;
+    outb(I8042_DATA, data);
+    return 0;
+}
+
+/*
+ * Send a controller command and read its one-byte result, -1 on timeout
+ */
+static int i8042_ctrl_read(uint8_t command) {
+    if (i8042_ctrl(command) != 0) return -1;
+    if (i8042_wait(STATUS_OUTPUT_FULL, STATUS_OUTPUT_FULL, I8042_CTRL_TIMEOUT_US) != 0) return -1;
+    return inb(I8042_DATA);
+}
+
+/*
+ * Discard whatever the controller has buffered
+ */
+static void i8042_flush(void) {
+    for (int i = 0; i < FLUSH_LIMIT && (inb(I8042_STATUS) & STATUS_OUTPUT_FULL); i++) {
+        inb(I8042_DATA);
+    }
+}
+
+/*
+ * Send one byte to a device
+ */
+static void i8042_write_device(int port, uint8_t data) {
+    if (port == I8042_PORT_AUX) {
+        i8042_ctrl(CTRL_WRITE_AUX);
+    }
+    if (i8042_wait(STATUS_INPUT_FULL, 0, I8042_CTRL_TIMEOUT_US) == 0) {
+        outb(I8042_DATA, data);
+    }
+    /* A lost byte shows up as a command timeout */
+}
+
+/*
+ * IRQ1 / IRQ12 top half - only queues the byte for the softirq
+ * The status register says which port it came from.
+ */
+static int i8042_irq(void* ctx) {
+    (void)ctx;
+    uint8_t status = inb(I8042_STATUS);
+    if (!(status & STATUS_OUTPUT_FULL)) {
+        return IRQ_NONE;
+    }
+
+    uint8_t data = inb(I8042_DATA);
+    int port = (status & STATUS_AUX_DATA) ? I8042_PORT_AUX : I8042_PORT_KEYBOARD;
+    byte_ring_push(&ports[port].ring, data, clock_cycles());
+    softirq_raise(SOFTIRQ_PS2);
+    return IRQ_HANDLED;
+}
+
+/*
+ * Send the next byte of a port's command
+ * A byte the controller already holds is queued first, so everything
+ * stamped before written_tsc was sent before the device saw the command.
+ */
+static void i8042_send(int index, uint8_t data) {
+    uint32_t flags = cpu_irq_save();
+    i8042_irq(0);
+    ports[index].written_tsc = clock_cycles();
+    i8042_write_device(index, data);
+    cpu_irq_restore(flags);
+}
+
+/*
+ * IRQ0 companion - raise the softirq once a command deadline has passed
+ * Never claims the interrupt; the timer driver does.
+ */
+static int i8042_timeout_watch(void* ctx) {
+    (void)ctx;
+    uint64_t now = timer_uptime_ms();
+    for (int i = 0; i < I8042_PORTS; i++) {
+        if (!ports[i].busy) {
+            continue;
+        }
+        if (now >= ports[i].deadline_ms) {
+            softirq_raise(SOFTIRQ_PS2);
+        } else {
+            /* Woken for an earlier deadline - ours needs arming again */
+            timer_wakeup_at(ports[i].deadline_ms);
+        }
+    }
+    return IRQ_NONE;
+}
+
+/*
+ * Start the command at the head of a port's queue (interrupts off)
+ */
+static void i8042_start(int index) {
+    port_t* port = &ports[index];
+    command_t* cmd = &port->queue[port->head];
+
+    port->busy = 1;
+    port->sent = 0;
+    port->resends = 0;
+    port->received = 0;
+    port->deadline_ms = timer_uptime_ms() + cmd->timeout_ms;
+    timer_wakeup_at(port->deadline_ms);
+    i8042_send(index, cmd->bytes[0]);
+}
+
+/*
+ * Finish the head command and start the next one
+ * A failure aborts everything queued behind it.
+ */
+static void i8042_complete(int index, int status) {
+    port_t* port = &ports[index];
+
+    uint32_t flags = cpu_irq_save();
+    command_t cmd = port->queue[port->head];
+    uint8_t reply[I8042_MAX_REPLY];
+    for (int i = 0; i < I8042_MAX_REPLY; i++) {
+        reply[i] = port->reply[i];
+    }
+
+    int aborted = 0;
+    command_t dropped[I8042_QUEUE_SIZE];
+    port->head = (port->head + 1) % I8042_QUEUE_SIZE;
+    port->count--;
+    port->busy = 0;
+
+    if (status != I8042_OK) {
+        while (port->count > 0) {
+            dropped[aborted++] = port->queue[port->head];
+            port->head = (port->head + 1) % I8042_QUEUE_SIZE;
+            port->count--;
+        }
+    } else if (port->count > 0) {
+        i8042_start(index);
+    }
+    cpu_irq_restore(flags);
+
+    /* Callbacks may queue new commands */
+    if (cmd.done) {
+        cmd.done(index, status, reply, cmd.ctx);
+    }
+    for (int i = 0; i < aborted; i++) {
+        if (dropped[i].done) {
+            dropped[i].done(index, I8042_ABORTED, reply, dropped[i].ctx);
+        }
+    }
+}
+
+/*
+ * Route one byte: to the command in flight, or to the receiver
+ */
+static void i8042_route(int index, uint8_t data, uint64_t tsc) {
+    port_t* port = &ports[index];
+
+    /* Bytes from before the command was written are stream data */
+    if (port->busy && tsc >= port->written_tsc) {
+        command_t* cmd = &port->queue[port->head];
+
+        if (port->sent < cmd->len) {
+            /* Waiting for an ACK */
+            if (data == DEV_ACK) {
+                if (++port->sent < cmd->len) {
+                    i8042_send(index, cmd->bytes[port->sent]);
+                } else if (cmd->reply_len == 0) {
+                    i8042_complete(index, I8042_OK);
+                }
+                return;
+            }
+            if (data == DEV_RESEND) {
+                if (++port->resends > I8042_MAX_RESENDS) {
+                    i8042_complete(index, I8042_ERROR);
+                } else {
+                    i8042_send(index, cmd->bytes[port->sent]);
+                }
+                return;
+            }
+            if (data == DEV_ERROR) {
+                i8042_complete(index, I8042_ERROR);
+                return;
+            }
+            /* Anything else is stream data that was already on its way */
+        } else {
+            port->reply[port->received++] = data;
+            if (port->received == cmd->reply_len) {
+                i8042_complete(index, I8042_OK);
+            }
+            return;
+        }
+    }
+
+    if (port->receive) {
+        port->receive(data, tsc);
+    }
+}
+
+/*
+ * PS/2 bottom half - route queued bytes, then expire overdue commands
+ */
+static void i8042_softirq(void) {
+    ring_byte_t raw;
+
+    for (int i = 0; i < I8042_PORTS; i++) {
+        int any = 0;
+        while (byte_ring_pop(&ports[i].ring, &raw)) {
+            i8042_route(i, raw.data, raw.tsc);
+            any = 1;
+        }
+        if (any && ports[i].drained) {
+            ports[i].drained();
+        }
+    }
+
+    uint64_t now = timer_uptime_ms();
+    for (int i = 0; i < I8042_PORTS; i++) {
+        if (ports[i].busy && now >= ports[i].deadline_ms) {
+            i8042_complete(i, I8042_TIMEOUT);
+        }
+    }
+}
+
+/*
+ * Bring up the controller and test both ports
+ */
+int i8042_init(void) {
+    uint32_t flags = cpu_irq_save();
+
+    /* Quiet both devices while the controller is reprogrammed */
+    i8042_ctrl(CTRL_DISABLE_KBD);
+    i8042_ctrl(CTRL_DISABLE_AUX);
+    i8042_flush();
+
+    int config = i8042_ctrl_read(CTRL_READ_CONFIG);
+    if (config < 0) {
+        cpu_irq_restore(flags);
+        return 0;   /* Nothing answers - no controller */
+    }
+    config &= ~(CONFIG_KBD_IRQ | CONFIG_AUX_IRQ);
+    i8042_ctrl_write(CTRL_WRITE_CONFIG, config);
+
+    /* Self-test; some controllers reset their configuration doing it */
+    if (i8042_ctrl_read(CTRL_SELF_TEST) != SELF_TEST_PASSED) {
+        cpu_irq_restore(flags);
+        return 0;
+    }
+    i8042_ctrl_write(CTRL_WRITE_CONFIG, config);
+
+    /* A single-port controller ignores the aux enable */
+    int dual = 0;
+    i8042_ctrl(CTRL_ENABLE_AUX);
+    int check = i8042_ctrl_read(CTRL_READ_CONFIG);
+    if (check >= 0 && !(check & CONFIG_AUX_DISABLED)) {
+        dual = 1;
+        i8042_ctrl(CTRL_DISABLE_AUX);
+    }
+
+    ports[I8042_PORT_KEYBOARD].present =
+        i8042_ctrl_read(CTRL_TEST_KEYBOARD) == PORT_TEST_PASSED;
+    ports[I8042_PORT_AUX].present =
+        dual && i8042_ctrl_read(CTRL_TEST_AUX) == PORT_TEST_PASSED;
+
+    /* Enable the working ports and their interrupts */
+    if (ports[I8042_PORT_KEYBOARD].present) {
+        i8042_ctrl(CTRL_ENABLE_KBD);
+        config |= CONFIG_KBD_IRQ;
+    }
+    if (ports[I8042_PORT_AUX].present) {
+        i8042_ctrl(CTRL_ENABLE_AUX);
+        config |= CONFIG_AUX_IRQ;
+    }
+    i8042_ctrl_write(CTRL_WRITE_CONFIG, config);
+    i8042_flush();
+
+    softirq_register(SOFTIRQ_PS2, i8042_softirq);
+    irq_register(0, i8042_timeout_watch, 0);
+
+    int working = 0;
+    for (int i = 0; i < I8042_PORTS; i++) {
+        if (ports[i].present) {
+            irq_register(irq_lines[i], i8042_irq, 0);
+            irq_unmask(irq_lines[i]);
+            working++;
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return working;
+}
+
+/*
+ * Check whether a port is usable
+ */
+int i8042_port_present(int port) {
+    return port >= 0 && port < I8042_PORTS && ports[port].present;
+}
+
+/*
+ * Set the handlers for a port's stream data
+ */
+void i8042_set_receiver(int port, i8042_receive_t receive, i8042_drained_t drained) {
+    if (port >= 0 && port < I8042_PORTS) {
+        uint32_t flags = cpu_irq_save();
+        ports[port].receive = receive;
+        ports[port].drained = drained;
+        cpu_irq_restore(flags);
+    }
+}
+
+/*
+ * Queue a device command; it starts at once if the port is idle
+ */
+int i8042_command(int port, const uint8_t* bytes, int len, int reply_len,
+                  uint32_t timeout_ms, i8042_done_t done, void* ctx) {
+    if (!i8042_port_present(port) || len < 1 || len > I8042_MAX_CMD ||
+        reply_len < 0 || reply_len > I8042_MAX_REPLY) {
+        return -1;
+    }
+
+    port_t* p = &ports[port];
+    uint32_t flags = cpu_irq_save();
+    if (p->count == I8042_QUEUE_SIZE) {
+        cpu_irq_restore(flags);
+        return -1;
+    }
+
+    command_t* cmd = &p->queue[(p->head + p->count) % I8042_QUEUE_SIZE];
+    for (int i = 0; i < len; i++) {
+        cmd->bytes[i] = bytes[i];
+    }
+    cmd->len = len;
+    cmd->reply_len = reply_len;
+    cmd->timeout_ms = timeout_ms;
+    cmd->done = done;
+    cmd->ctx = ctx;
+
+    if (p->count++ == 0) {
+        i8042_start(port);
+    }
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+int i8042_command1(int port, uint8_t command, uint32_t timeout_ms,
+                   i8042_done_t done, void* ctx) {
+    return i8042_command(port, &command, 1, 0, timeout_ms, done, ctx);
+}
+
+int i8042_command2(int port, uint8_t command, uint8_t arg, uint32_t timeout_ms,
+                   i8042_done_t done, void* ctx) {
+    uint8_t bytes[2] = { command, arg };
+    return i8042_command(port, bytes, 2, 0, timeout_ms, done, ctx);
+}
@@ -5,14 +5,13 @@
 
 #include "../include/idt.h"
 #include "../include/pic.h"
+#include "../include/irq.h"
 #include "../include/io.h"
 #include "../include/vga.h"
-
-/* Forward declaration for keyboard handler if available */
-extern void keyboard_handler(void) __attribute__((weak));
-
-/* Forward declaration for mouse handler if available */
-extern void mouse_handler(void) __attribute__((weak));
+#include "../include/thread.h"
+#include "../include/taskpool.h"
+#include "../include/apic.h"
+#include "../include/softirq.h"
 
 /* IDT with 256 entries */
 static idt_entry_t idt[IDT_ENTRIES];
@@ -67,8 +66,9 @@ void idt_set_gate(uint8_t num, uint32_t base, uint16_t selector, uint8_t flags)
 
 /**
  * Load the IDT register using lidt instruction
+ * Application processors share the BSP's table and just load it.
  */
-static void idt_load(void) {
+void idt_load(void) {
     __asm__ volatile ("lidt %0" : : "m"(idt_ptr));
 }
 
@@ -223,38 +223,40 @@ void isr_handler(registers_t *regs) {
 
 /**
  * IRQ handler - called from assembly stub for hardware interrupts
+ * Returns the frame to resume, which belongs to another thread when the
+ * scheduler switches.
  */
-void irq_handler(registers_t *regs) {
-    /* Calculate the IRQ number (interrupt 32-47 = IRQ 0-15) */
-    uint8_t irq = regs->int_no - 32;
+registers_t* irq_handler(registers_t *regs) {
+    /* Voluntary thread switch - a software interrupt, no EOI */
+    if (regs->int_no == THREAD_YIELD_VECTOR) {
+        return thread_yield_handler(regs);
+    }
 
-    /* Dispatch to specific handlers */
-    switch (irq) {
-        case 0:  /* Timer (PIT) - IRQ0 */
-            /* Timer tick handler would go here */
-            break;
+    /* Task pool wakeup IPI - waking the CPU from hlt is all it does */
+    if (regs->int_no == TASKPOOL_WAKE_VECTOR) {
+        apic_eoi();
+        return regs;
+    }
 
-        case 1:  /* Keyboard - IRQ1 */
-            if (keyboard_handler) {
-                keyboard_handler();
-            }
-            break;
+    /* Calculate the IRQ number (interrupt 32-47 = IRQ 0-15) */
+    uint8_t irq = regs->int_no - 32;
 
-        case 2:  /* Cascade - IRQ2 */
-            /* Used internally by the PICs */
-            break;
+    /* Run the registered driver handlers */
+    if (!irq_dispatch(irq)) {
+        return regs;    /* Spurious - no EOI */
+    }
 
-        case 12: /* PS/2 Mouse - IRQ12 */
-            if (mouse_handler) {
-                mouse_handler();
-            }
-            break;
+    /* Send End of Interrupt to the interrupt controller */
+    irq_eoi(irq);
 
-        default:
-            /* Unhandled IRQ - just acknowledge it */
-            break;
+    /* Interrupted a softirq: it picks up our work, its exit schedules */
+    if (softirq_active()) {
+        return regs;
     }
 
-    /* Send End of Interrupt to PIC */
-    pic_send_eoi(irq);
+    /* Bottom halves (input decoding) with interrupts enabled */
+    softirq_run();
+
+    /* Preempt if the interrupt woke a thread or the time slice is over */
+    return thread_irq_exit(regs);
 }
@@ -0,0 +1,53 @@
+/*
+ * AJOS Input Event Queue
+ * Single-producer / single-consumer ring of keyboard and mouse events
+ */
+
+#include "input.h"
+#include "atomic.h"
+
+static input_event_t queue[INPUT_QUEUE_SIZE];
+static atomic_t head = ATOMIC_INIT(0);     /* Next slot to fill (producer) */
+static atomic_t tail = ATOMIC_INIT(0);     /* Next slot to read (consumer) */
+static uint32_t dropped = 0;
+
+/*
+ * Append an event
+ */
+int input_push(const input_event_t* event) {
+    uint32_t h = atomic_load(&head);
+    if (h - atomic_load(&tail) >= INPUT_QUEUE_SIZE) {
+        dropped++;
+        return 0;
+    }
+    queue[h & (INPUT_QUEUE_SIZE - 1)] = *event;
+    atomic_store(&head, h + 1);     /* Publishes the slot */
+    return 1;
+}
+
+/*
+ * Take the oldest event
+ */
+int input_pop(input_event_t* event) {
+    uint32_t t = atomic_load(&tail);
+    if (t == atomic_load(&head)) {
+        return 0;
+    }
+    *event = queue[t & (INPUT_QUEUE_SIZE - 1)];
+    atomic_store(&tail, t + 1);     /* Frees the slot */
+    return 1;
+}
+
+/*
+ * Check for waiting events
+ */
+int input_pending(void) {
+    return atomic_load(&tail) != atomic_load(&head);
+}
+
+/*
+ * Number of events lost to a full queue
+ */
+uint32_t input_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,190 @@
+/*
+ * AJOS Interrupt Controller Front End
+ * Chooses between the APIC and the legacy 8259 PIC
+ */
+
+#include "irq.h"
+#include "pic.h"
+#include "apic.h"
+#include "cpu.h"
+#include "clock.h"
+
+static int use_apic = 0;
+
+/* Registered handlers, chained per line */
+typedef struct irq_action {
+    irq_handler_t handler;
+    void* ctx;
+    struct irq_action* next;
+} irq_action_t;
+
+static irq_action_t actions[IRQ_MAX_HANDLERS];
+static int action_count = 0;
+static irq_action_t* lines[IRQ_LINES];
+static irq_stats_t stats[IRQ_LINES];
+
+/*
+ * Initialize interrupt delivery
+ * The PIC is always remapped first; if the APIC comes up it takes over
+ * and the PIC is masked, otherwise the PIC keeps handling IRQs.
+ */
+void irq_init(void) {
+    uint32_t flags = cpu_irq_save();
+
+    pic_init();
+    if (apic_init() == 0) {
+        pic_disable();
+        use_apic = 1;
+    }
+
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Enable an IRQ line
+ */
+void irq_unmask(uint8_t irq) {
+    if (use_apic) {
+        ioapic_set_masked(irq, 0);
+    } else {
+        pic_clear_mask(irq);
+    }
+}
+
+/*
+ * Disable an IRQ line
+ */
+void irq_mask(uint8_t irq) {
+    if (use_apic) {
+        ioapic_set_masked(irq, 1);
+    } else {
+        pic_set_mask(irq);
+    }
+}
+
+/*
+ * Acknowledge an interrupt - one MMIO write with the APIC
+ */
+void irq_eoi(uint8_t irq) {
+    if (use_apic) {
+        apic_eoi();
+    } else {
+        pic_send_eoi(irq);
+    }
+}
+
+/*
+ * Name of the controller in charge
+ */
+const char* irq_controller_name(void) {
+    return use_apic ? "apic" : "pic";
+}
+
+/*
+ * Add a handler to an IRQ line (after any already there)
+ */
+int irq_register(uint8_t irq, irq_handler_t handler, void* ctx) {
+    if (irq >= IRQ_LINES || !handler) {
+        return -1;
+    }
+
+    uint32_t flags = cpu_irq_save();
+    if (action_count == IRQ_MAX_HANDLERS) {
+        cpu_irq_restore(flags);
+        return -1;
+    }
+
+    irq_action_t* action = &actions[action_count++];
+    action->handler = handler;
+    action->ctx = ctx;
+    action->next = 0;
+
+    irq_action_t** link = &lines[irq];
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = action;
+    stats[irq].handlers++;
+
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+/*
+ * Check for a spurious PIC interrupt
+ * The 8259 reports a request that vanished before the CPU acknowledged it
+ * as IRQ7 (or IRQ15 on the slave) without setting its in-service bit.
+ */
+static int irq_is_spurious(uint8_t irq) {
+    if (use_apic || (irq != 7 && irq != 15)) {
+        return 0;
+    }
+    if (pic_get_isr() & (1 << irq)) {
+        return 0;
+    }
+
+    /* The master did see a real request on the cascade line */
+    if (irq == 15) {
+        pic_send_eoi(2);
+    }
+    return 1;
+}
+
+/*
+ * Record how long the handlers of a line took
+ */
+static void irq_account(irq_stats_t* st, uint64_t cycles) {
+    uint64_t limit = clock_get_tsc_khz() / 1000;    /* Cycles per us */
+    int bucket = 0;
+
+    while (bucket < IRQ_HIST_BUCKETS - 1 && cycles >= limit) {
+        limit <<= 1;
+        bucket++;
+    }
+    st->hist[bucket]++;
+    st->total_cycles += cycles;
+    if (cycles > st->max_cycles) {
+        st->max_cycles = cycles;
+    }
+}
+
+/*
+ * Run every handler on an IRQ line
+ */
+int irq_dispatch(uint8_t irq) {
+    if (irq >= IRQ_LINES) {
+        return 1;
+    }
+
+    irq_stats_t* st = &stats[irq];
+    if (irq_is_spurious(irq)) {
+        st->spurious++;
+        return 0;
+    }
+
+    uint64_t start = clock_cycles();
+    int handled = IRQ_NONE;
+    for (irq_action_t* action = lines[irq]; action; action = action->next) {
+        handled |= action->handler(action->ctx);
+    }
+    irq_account(st, clock_cycles() - start);
+
+    st->count++;
+    if (!handled) {
+        st->unhandled++;
+    }
+    return 1;
+}
+
+/*
+ * Copy one line's statistics
+ */
+int irq_get_stats(uint8_t irq, irq_stats_t* out) {
+    if (irq >= IRQ_LINES) {
+        return 0;
+    }
+    uint32_t flags = cpu_irq_save();
+    *out = stats[irq];
+    cpu_irq_restore(flags);
+    return 1;
+}
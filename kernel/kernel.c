@@ -1,8 +1,16 @@
 #include "vga.h"
-#include "gdt.h"
+#include "cpu.h"
+#include "heap.h"
+#include "smp.h"
+#include "thread.h"
+#include "taskpool.h"
 #include "idt.h"
-#include "pic.h"
+#include "irq.h"
+#include "i8042.h"
 #include "keyboard.h"
+#include "rtc.h"
+#include "timer.h"
+#include "clock.h"
 #include "shell.h"
 #include "graphics.h"
 #include "desktop.h"
@@ -14,28 +22,52 @@
  * @param multiboot_info Pointer to multiboot info structure passed by GRUB
  */
 void kernel_main(void* multiboot_info) {
-    /* Step 1: Initialize graphics from multiboot info */
+    /* Step 1: Detect CPU features (enables SSE for the present path) */
+    cpu_init();
+
+    /* Step 2: Initialize kernel heap from multiboot memory info */
+    heap_init(multiboot_info);
+
+    /* Step 3: Initialize graphics from multiboot info */
     graphics_init(multiboot_info);
 
-    /* Step 2: Initialize VGA text mode (fallback if no graphics) */
+    /* Step 4: Initialize VGA text mode (fallback if no graphics) */
     vga_init();
 
-    /* Step 3: Initialize Global Descriptor Table */
-    gdt_init();
+    /* Step 5: Initialize the bootstrap CPU's GDT, TSS and per-CPU data */
+    smp_init_bsp();
 
-    /* Step 4: Initialize Interrupt Descriptor Table */
+    /* Step 6: Initialize Interrupt Descriptor Table */
     idt_init();
 
-    /* Step 5: Initialize and remap the PIC (Programmable Interrupt Controller) */
-    pic_init();
+    /* Step 7: Initialize interrupt controllers (I/O APIC if present, else PIC) */
+    irq_init();
+
+    /* Step 8: Start the system tick, calibrate the TSC clock against the */
+    /* PIT, turn on the RTC once-a-second interrupt and, with an APIC, */
+    /* hand timekeeping over to tickless local APIC deadlines */
+    timer_init(TIMER_DEFAULT_HZ);
+    clock_init();
+    rtc_init();
+    timer_enable_tickless();
 
-    /* Step 6: Initialize keyboard driver */
+    /* Step 9: Initialize the PS/2 controller and keyboard driver */
+    /* (after the clock, which bounds every controller wait) */
+    i8042_init();
     keyboard_init();
 
-    /* Step 7: Enable interrupts */
+    /* Step 10: Wake the other CPUs (needs the local APIC and the clock) */
+    /* and hand them to the task pool */
+    smp_init();
+    taskpool_init();
+
+    /* Step 11: Become the main thread and start the scheduler */
+    thread_init();
+
+    /* Step 12: Enable interrupts */
     __asm__ volatile ("sti");
 
-    /* Step 8: Check for graphics mode and run appropriate interface */
+    /* Step 13: Check for graphics mode and run appropriate interface */
     if (graphics_is_available()) {
         /* Graphics mode available - run desktop environment */
         desktop_init();
@@ -1,171 +1,214 @@
 /**
  * AJOS PS/2 Keyboard Driver
- * Handles keyboard input via IRQ1 (Interrupt 33)
- * Uses Scancode Set 1 (US QWERTY layout)
+ * Turns scancode set 1 into key events with software autorepeat
+ * (US QWERTY layout, see KEYBOARD_KEYS in keyboard.h)
  */
 
 #include "../include/keyboard.h"
-#include "../include/io.h"
-#include "../include/pic.h"
-
-/* Circular buffer for keystrokes */
-static char keyboard_buffer[KEYBOARD_BUFFER_SIZE];
-static volatile uint8_t buffer_head = 0;
-static volatile uint8_t buffer_tail = 0;
-
-/* Shift key state */
-static volatile uint8_t shift_pressed = 0;
-static volatile uint8_t caps_lock = 0;
-
-/* Scancode to ASCII lookup table (lowercase, Scancode Set 1) */
-static const char scancode_to_ascii[128] = {
-    0,    0x1B, '1',  '2',  '3',  '4',  '5',  '6',   /* 0x00 - 0x07 */
-    '7',  '8',  '9',  '0',  '-',  '=',  '\b', '\t',  /* 0x08 - 0x0F */
-    'q',  'w',  'e',  'r',  't',  'y',  'u',  'i',   /* 0x10 - 0x17 */
-    'o',  'p',  '[',  ']',  '\n', 0,    'a',  's',   /* 0x18 - 0x1F */
-    'd',  'f',  'g',  'h',  'j',  'k',  'l',  ';',   /* 0x20 - 0x27 */
-    '\'', '`',  0,    '\\', 'z',  'x',  'c',  'v',   /* 0x28 - 0x2F */
-    'b',  'n',  'm',  ',',  '.',  '/',  0,    '*',   /* 0x30 - 0x37 */
-    0,    ' ',  0,    0,    0,    0,    0,    0,     /* 0x38 - 0x3F */
-    0,    0,    0,    0,    0,    0,    0,    '7',   /* 0x40 - 0x47 */
-    '8',  '9',  '-',  '4',  '5',  '6',  '+',  '1',   /* 0x48 - 0x4F */
-    '2',  '3',  '0',  '.',  0,    0,    0,    0,     /* 0x50 - 0x57 */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x58 - 0x5F */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x60 - 0x67 */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x68 - 0x6F */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x70 - 0x77 */
-    0,    0,    0,    0,    0,    0,    0,    0      /* 0x78 - 0x7F */
+#include "../include/clock.h"
+#include "../include/cpu.h"
+#include "../include/i8042.h"
+#include "../include/input.h"
+#include "../include/irq.h"
+#include "../include/softirq.h"
+#include "../include/timer.h"
+
+/* Device commands */
+#define KEYBOARD_CMD_TYPEMATIC  0xF3
+#define KEYBOARD_CMD_ENABLE     0xF4
+#define KEYBOARD_CMD_TIMEOUT_MS 100
+
+/*
+ * Slowest hardware typematic: 1000 ms delay, then 2 repeats/s. Repeats
+ * are generated in software, so the keyboard's own repeat bytes are only
+ * interrupt load and get dropped.
+ */
+#define KEYBOARD_TYPEMATIC_SLOWEST 0x7F
+
+/* Scancode prefixes and the release bit */
+#define SCANCODE_EXTENDED       0xE0
+#define SCANCODE_PAUSE          0xE1    /* Followed by two bytes, twice */
+#define SCANCODE_RELEASE        0x80
+
+/* Keycode to key, unshifted and shifted - generated from KEYBOARD_KEYS */
+#define KEYBOARD_KEY_PLAIN(name, code, key, shifted)   [code] = key,
+#define KEYBOARD_KEY_SHIFTED(name, code, key, shifted) [code] = shifted,
+
+static const uint8_t keycode_to_key[KEYCODE_COUNT] = {
+    KEYBOARD_KEYS(KEYBOARD_KEY_PLAIN)
+};
+
+static const uint8_t keycode_to_key_shift[KEYCODE_COUNT] = {
+    KEYBOARD_KEYS(KEYBOARD_KEY_SHIFTED)
 };
 
-/* Scancode to ASCII lookup table (shifted/uppercase) */
-static const char scancode_to_ascii_shift[128] = {
-    0,    0x1B, '!',  '@',  '#',  '$',  '%',  '^',   /* 0x00 - 0x07 */
-    '&',  '*',  '(',  ')',  '_',  '+',  '\b', '\t',  /* 0x08 - 0x0F */
-    'Q',  'W',  'E',  'R',  'T',  'Y',  'U',  'I',   /* 0x10 - 0x17 */
-    'O',  'P',  '{',  '}',  '\n', 0,    'A',  'S',   /* 0x18 - 0x1F */
-    'D',  'F',  'G',  'H',  'J',  'K',  'L',  ':',   /* 0x20 - 0x27 */
-    '"',  '~',  0,    '|',  'Z',  'X',  'C',  'V',   /* 0x28 - 0x2F */
-    'B',  'N',  'M',  '<',  '>',  '?',  0,    '*',   /* 0x30 - 0x37 */
-    0,    ' ',  0,    0,    0,    0,    0,    0,     /* 0x38 - 0x3F */
-    0,    0,    0,    0,    0,    0,    0,    '7',   /* 0x40 - 0x47 */
-    '8',  '9',  '-',  '4',  '5',  '6',  '+',  '1',   /* 0x48 - 0x4F */
-    '2',  '3',  '0',  '.',  0,    0,    0,    0,     /* 0x50 - 0x57 */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x58 - 0x5F */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x60 - 0x67 */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x68 - 0x6F */
-    0,    0,    0,    0,    0,    0,    0,    0,     /* 0x70 - 0x77 */
-    0,    0,    0,    0,    0,    0,    0,    0      /* 0x78 - 0x7F */
+/* Modifier keys, INPUT_MOD_* */
+static const uint8_t keycode_modifier[KEYCODE_COUNT] = {
+    [KEYCODE_LEFT_SHIFT]  = INPUT_MOD_SHIFT,
+    [KEYCODE_RIGHT_SHIFT] = INPUT_MOD_SHIFT,
+    [KEYCODE_LEFT_CTRL]   = INPUT_MOD_CTRL,
+    [KEYCODE_RIGHT_CTRL]  = INPUT_MOD_CTRL,
+    [KEYCODE_LEFT_ALT]    = INPUT_MOD_ALT,
+    [KEYCODE_RIGHT_ALT]   = INPUT_MOD_ALT,
 };
 
-/* Scancode constants */
-#define SCANCODE_LEFT_SHIFT_PRESS    0x2A
-#define SCANCODE_LEFT_SHIFT_RELEASE  0xAA
-#define SCANCODE_RIGHT_SHIFT_PRESS   0x36
-#define SCANCODE_RIGHT_SHIFT_RELEASE 0xB6
-#define SCANCODE_CAPS_LOCK           0x3A
-#define SCANCODE_CTRL                0x1D
-#define SCANCODE_ALT                 0x38
-#define SCANCODE_EXTENDED            0xE0
-
-/* Extended key scancodes (after 0xE0 prefix) */
-#define SCANCODE_EXT_UP              0x48
-#define SCANCODE_EXT_DOWN            0x50
-#define SCANCODE_EXT_LEFT            0x4B
-#define SCANCODE_EXT_RIGHT           0x4D
-
-/* Extended scancode state */
-static volatile uint8_t extended_scancode = 0;
+/* Held keys, one bit per keycode (written by the softirq only) */
+static volatile uint32_t key_state[KEYCODE_COUNT / 32];
 
-/**
- * Add a character to the keyboard buffer
+/* Modifier state, INPUT_MOD_* (written by the softirq only) */
+static volatile uint8_t modifiers = 0;
+
+/* Decoder state between bytes */
+static uint8_t extended_scancode = 0;
+static uint8_t pause_skip = 0;
+
+/*
+ * Autorepeat: the last key pressed repeats while it is held. The deadline
+ * is read by the IRQ0 watcher, so it changes with interrupts off.
  */
-static void buffer_put(char c) {
-    uint8_t next = (buffer_head + 1) % KEYBOARD_BUFFER_SIZE;
+static uint8_t repeat_keycode = 0;     /* 0 = nothing repeating */
+static volatile uint64_t repeat_deadline_ms = TIMER_NO_DEADLINE;
 
-    /* Don't overwrite if buffer is full */
-    if (next != buffer_tail) {
-        keyboard_buffer[buffer_head] = c;
-        buffer_head = next;
-    }
+/*
+ * Check whether a key is held down
+ */
+int keyboard_key_down(uint8_t keycode) {
+    return (key_state[keycode / 32] >> (keycode % 32)) & 1;
 }
 
-/**
- * Get a character from the keyboard buffer
- * Returns 0 if buffer is empty
+/*
+ * Record a key going down or up
  */
-static char buffer_get(void) {
-    if (buffer_head == buffer_tail) {
-        return 0;  /* Buffer empty */
+static void keyboard_set_key(uint8_t keycode, int down) {
+    if (down) {
+        key_state[keycode / 32] |= 1u << (keycode % 32);
+    } else {
+        key_state[keycode / 32] &= ~(1u << (keycode % 32));
     }
-
-    char c = keyboard_buffer[buffer_tail];
-    buffer_tail = (buffer_tail + 1) % KEYBOARD_BUFFER_SIZE;
-    return c;
 }
 
-/**
- * Check if buffer has data
+/*
+ * Recompute the held modifiers from the key state (Caps Lock is kept)
  */
-static int buffer_has_data(void) {
-    return buffer_head != buffer_tail;
+static void keyboard_update_modifiers(void) {
+    uint8_t mod = modifiers & INPUT_MOD_CAPS;
+    for (int i = 0; i < KEYCODE_COUNT; i++) {
+        if (keycode_modifier[i] && keyboard_key_down(i)) {
+            mod |= keycode_modifier[i];
+        }
+    }
+    modifiers = mod;
 }
 
-/**
- * Convert scancode to ASCII character
+/*
+ * Key value for a keycode under the current modifiers (0 if none)
  */
-static char scancode_to_char(uint8_t scancode) {
-    /* Ignore key releases (bit 7 set) for character conversion */
-    if (scancode >= 0x80) {
-        return 0;
+static uint8_t keyboard_key_value(uint8_t keycode) {
+    uint8_t key;
+
+    if (modifiers & INPUT_MOD_SHIFT) {
+        key = keycode_to_key_shift[keycode];
+    } else {
+        key = keycode_to_key[keycode];
     }
 
-    char c;
+    /* Caps Lock inverts the case of letters only */
+    if ((modifiers & INPUT_MOD_CAPS) && key >= 'a' && key <= 'z') {
+        key = key - 'a' + 'A';
+    } else if ((modifiers & INPUT_MOD_CAPS) && key >= 'A' && key <= 'Z') {
+        key = key - 'A' + 'a';
+    }
 
-    /* Check if shift is pressed for special characters */
-    if (shift_pressed) {
-        c = scancode_to_ascii_shift[scancode];
-    } else {
-        c = scancode_to_ascii[scancode];
+    /* Ctrl with a letter gives the control character */
+    if ((modifiers & INPUT_MOD_CTRL) &&
+        ((key >= 'a' && key <= 'z') || (key >= 'A' && key <= 'Z'))) {
+        key = KEY_CTRL(key);
     }
 
-    /* Handle caps lock for letters only */
-    if (caps_lock && c >= 'a' && c <= 'z') {
-        c = c - 'a' + 'A';
-    } else if (caps_lock && c >= 'A' && c <= 'Z') {
-        c = c - 'A' + 'a';
+    return key;
+}
+
+/*
+ * Queue a key event
+ */
+static void keyboard_emit(uint8_t type, uint8_t keycode, int repeat, uint64_t tsc) {
+    input_event_t event = {0};
+    event.tsc = tsc;
+    event.type = type;
+    event.modifiers = modifiers;
+    event.scancode = keycode & ~KEYCODE_EXTENDED;
+    if (keycode & KEYCODE_EXTENDED) {
+        event.scancode |= INPUT_SCANCODE_EXTENDED;
+    }
+    event.keycode = keycode;
+    event.repeat = repeat;
+    if (type == INPUT_KEY_DOWN) {
+        event.key = keyboard_key_value(keycode);
     }
+    input_push(&event);
+}
 
-    return c;
+/*
+ * Set the next repeat time (TIMER_NO_DEADLINE stops repeating)
+ */
+static void keyboard_repeat_arm(uint64_t deadline_ms) {
+    uint32_t flags = cpu_irq_save();
+    repeat_deadline_ms = deadline_ms;
+    cpu_irq_restore(flags);
+    timer_wakeup_at(deadline_ms);
 }
 
-/**
- * Initialize the keyboard driver
+/*
+ * IRQ0 companion - raise the repeat softirq when a repeat is due
+ * Never claims the interrupt; the timer driver does.
  */
-void keyboard_init(void) {
-    /* Clear the buffer */
-    buffer_head = 0;
-    buffer_tail = 0;
-    shift_pressed = 0;
-    caps_lock = 0;
-
-    /* Flush keyboard buffer by reading any pending data */
-    while (inb(KEYBOARD_STATUS_PORT) & 0x01) {
-        inb(KEYBOARD_DATA_PORT);
+static int keyboard_repeat_watch(void* ctx) {
+    (void)ctx;
+    if (repeat_deadline_ms == TIMER_NO_DEADLINE) {
+        return IRQ_NONE;
+    }
+    if (timer_uptime_ms() >= repeat_deadline_ms) {
+        softirq_raise(SOFTIRQ_KEYBOARD);
+    } else {
+        /* Woken for an earlier deadline - ours needs arming again */
+        timer_wakeup_at(repeat_deadline_ms);
+    }
+    return IRQ_NONE;
+}
+
+/*
+ * Repeat softirq - send the held key again
+ * Falls back into step after a stall instead of sending a burst.
+ */
+static void keyboard_repeat_softirq(void) {
+    uint64_t now = timer_uptime_ms();
+    if (!repeat_keycode || now < repeat_deadline_ms) {
+        return;
     }
 
-    /* Enable IRQ1 (keyboard interrupt) by clearing mask */
-    pic_clear_mask(1);
+    keyboard_emit(INPUT_KEY_DOWN, repeat_keycode, 1, clock_cycles());
+
+    uint64_t next = repeat_deadline_ms + KEYBOARD_REPEAT_INTERVAL_MS;
+    if (next <= now) {
+        next = now + KEYBOARD_REPEAT_INTERVAL_MS;
+    }
+    keyboard_repeat_arm(next);
 }
 
 /**
- * Keyboard interrupt handler (IRQ1)
- * Called from IRQ handler in idt.c
+ * Translate one scancode into a key event
+ * Called from the PS/2 softirq for every byte the keyboard sends.
  */
-void keyboard_handler(void) {
-    uint8_t scancode;
-
-    /* Read scancode from keyboard data port */
-    scancode = inb(KEYBOARD_DATA_PORT);
+static void keyboard_decode(uint8_t scancode, uint64_t tsc) {
+    /* Pause has no release; its make sequence is skipped whole */
+    if (pause_skip) {
+        pause_skip--;
+        return;
+    }
+    if (scancode == SCANCODE_PAUSE) {
+        pause_skip = 2;
+        return;
+    }
 
     /* Handle extended scancode prefix */
     if (scancode == SCANCODE_EXTENDED) {
@@ -173,89 +216,102 @@ void keyboard_handler(void) {
         return;
     }
 
-    /* Handle extended scancodes (arrow keys, etc.) */
+    int release = scancode & SCANCODE_RELEASE;
+    uint8_t keycode = scancode & ~SCANCODE_RELEASE;
+
     if (extended_scancode) {
         extended_scancode = 0;
-
-        /* Ignore key releases */
-        if (scancode >= 0x80) {
+        /* Fake shifts wrapped around navigation keys carry no information */
+        if (keycode == KEYCODE_LEFT_SHIFT || keycode == KEYCODE_RIGHT_SHIFT) {
             return;
         }
-
-        /* Map extended scancodes to special key values */
-        switch (scancode) {
-            case SCANCODE_EXT_UP:
-                buffer_put(KEY_UP);
-                break;
-            case SCANCODE_EXT_DOWN:
-                buffer_put(KEY_DOWN);
-                break;
-            case SCANCODE_EXT_LEFT:
-                buffer_put(KEY_LEFT);
-                break;
-            case SCANCODE_EXT_RIGHT:
-                buffer_put(KEY_RIGHT);
-                break;
-        }
-        return;
+        keycode |= KEYCODE_EXTENDED;
     }
-
-    /* Handle shift key press/release */
-    if (scancode == SCANCODE_LEFT_SHIFT_PRESS ||
-        scancode == SCANCODE_RIGHT_SHIFT_PRESS) {
-        shift_pressed = 1;
-        return;
+    if (keycode == 0) {
+        return;     /* Key detection error or buffer overrun */
     }
 
-    if (scancode == SCANCODE_LEFT_SHIFT_RELEASE ||
-        scancode == SCANCODE_RIGHT_SHIFT_RELEASE) {
-        shift_pressed = 0;
+    /* Hardware typematic - the key is already down */
+    if (!release && keyboard_key_down(keycode)) {
         return;
     }
+    keyboard_set_key(keycode, !release);
 
-    /* Handle caps lock (toggle on press only) */
-    if (scancode == SCANCODE_CAPS_LOCK) {
-        caps_lock = !caps_lock;
-        return;
+    if (keycode_modifier[keycode]) {
+        keyboard_update_modifiers();
+    } else if (keycode == KEYCODE_CAPS_LOCK && !release) {
+        modifiers ^= INPUT_MOD_CAPS;
     }
 
-    /* Ignore key releases for other keys */
-    if (scancode >= 0x80) {
-        return;
+    keyboard_emit(release ? INPUT_KEY_UP : INPUT_KEY_DOWN, keycode, 0, tsc);
+
+    /* Keys with a value repeat; modifiers and locks do not */
+    if (!release && keycode_to_key[keycode]) {
+        repeat_keycode = keycode;
+        keyboard_repeat_arm(timer_uptime_ms() + KEYBOARD_REPEAT_DELAY_MS);
+    } else if (release && keycode == repeat_keycode) {
+        repeat_keycode = 0;
+        keyboard_repeat_arm(TIMER_NO_DEADLINE);
     }
+}
 
-    /* Convert scancode to ASCII */
-    char c = scancode_to_char(scancode);
+/**
+ * Initialize the keyboard driver
+ * The commands complete in the background; boot does not wait for them.
+ */
+void keyboard_init(void) {
+    modifiers = 0;
 
-    /* Add valid characters to buffer */
-    if (c != 0) {
-        buffer_put(c);
-    }
+    softirq_register(SOFTIRQ_KEYBOARD, keyboard_repeat_softirq);
+    irq_register(0, keyboard_repeat_watch, 0);
+
+    i8042_set_receiver(I8042_PORT_KEYBOARD, keyboard_decode, 0);
+    i8042_command2(I8042_PORT_KEYBOARD, KEYBOARD_CMD_TYPEMATIC,
+                   KEYBOARD_TYPEMATIC_SLOWEST, KEYBOARD_CMD_TIMEOUT_MS, 0, 0);
+    i8042_command1(I8042_PORT_KEYBOARD, KEYBOARD_CMD_ENABLE,
+                   KEYBOARD_CMD_TIMEOUT_MS, 0, 0);
+}
+
+/**
+ * Get the current modifier state (INPUT_MOD_*)
+ */
+uint8_t keyboard_get_modifiers(void) {
+    return modifiers;
 }
 
 /**
  * Read one character from keyboard (blocking)
  */
 char keyboard_getchar(void) {
-    /* Wait until buffer has data */
-    while (!buffer_has_data()) {
+    char c;
+
+    /* Wait until a key with a character is pressed */
+    while ((c = keyboard_getchar_nonblocking()) == 0) {
         /* Halt CPU until next interrupt to save power */
         __asm__ volatile ("hlt");
     }
 
-    return buffer_get();
+    return c;
 }
 
 /**
- * Check if there are characters available
+ * Check if there is input waiting
  */
 int keyboard_has_data(void) {
-    return buffer_has_data();
+    return input_pending();
 }
 
 /**
  * Get character without blocking
+ * Takes events off the input queue until a key press that produces a
+ * character; everything else is discarded.
  */
 char keyboard_getchar_nonblocking(void) {
-    return buffer_get();
+    input_event_t event;
+    while (input_pop(&event)) {
+        if (event.type == INPUT_KEY_DOWN && event.key) {
+            return (char)event.key;
+        }
+    }
+    return 0;
 }
@@ -0,0 +1,106 @@
+/*
+ * AJOS Input Latency
+ * Per-stage histograms from input interrupt to presented frame
+ */
+
+#include "latency.h"
+#include "clock.h"
+#include "string.h"
+
+typedef struct {
+    uint64_t irq_tsc;
+    uint64_t dequeue_tsc;
+    uint64_t handled_tsc;
+} pending_t;
+
+static pending_t pending[LATENCY_MAX_PENDING];
+static int pending_count = 0;
+
+static latency_stats_t stats[LATENCY_STAGES];
+
+static const char* stage_names[LATENCY_STAGES] = {
+    "queue", "handle", "wait", "compose", "present", "total"
+};
+
+/*
+ * Add one measurement to a stage
+ */
+static void latency_account(int stage, uint64_t start, uint64_t end) {
+    latency_stats_t* st = &stats[stage];
+    uint64_t cycles = end > start ? end - start : 0;
+    uint64_t limit = (uint64_t)clock_get_tsc_khz() / 1000 * LATENCY_HIST_BASE_US;
+    int bucket = 0;
+
+    while (bucket < LATENCY_HIST_BUCKETS - 1 && cycles >= limit) {
+        limit <<= 1;
+        bucket++;
+    }
+    st->hist[bucket]++;
+    st->count++;
+    st->total_cycles += cycles;
+    if (cycles > st->max_cycles) {
+        st->max_cycles = cycles;
+    }
+}
+
+/*
+ * Queue an event for the next frame
+ * Events without an interrupt stamp (no TSC) are not measured.
+ */
+void latency_input_handled(uint64_t irq_tsc, uint64_t dequeue_tsc) {
+    if (!irq_tsc || pending_count >= LATENCY_MAX_PENDING) {
+        return;
+    }
+    pending_t* p = &pending[pending_count++];
+    p->irq_tsc = irq_tsc;
+    p->dequeue_tsc = dequeue_tsc;
+    p->handled_tsc = clock_cycles();
+}
+
+/*
+ * Account the events a frame has just shown
+ */
+void latency_frame(uint64_t start_tsc, uint64_t composed_tsc, uint64_t presented_tsc) {
+    for (int i = 0; i < pending_count; i++) {
+        pending_t* p = &pending[i];
+        latency_account(LATENCY_QUEUE, p->irq_tsc, p->dequeue_tsc);
+        latency_account(LATENCY_HANDLE, p->dequeue_tsc, p->handled_tsc);
+        latency_account(LATENCY_WAIT, p->handled_tsc, start_tsc);
+        latency_account(LATENCY_TOTAL, p->irq_tsc, presented_tsc);
+    }
+    if (pending_count) {
+        /* Once per frame - these do not depend on how many events it shows */
+        latency_account(LATENCY_COMPOSE, start_tsc, composed_tsc);
+        latency_account(LATENCY_PRESENT, composed_tsc, presented_tsc);
+    }
+    pending_count = 0;
+}
+
+/*
+ * Copy one stage's statistics
+ */
+void latency_get_stats(int stage, latency_stats_t* out) {
+    if (stage >= 0 && stage < LATENCY_STAGES) {
+        *out = stats[stage];
+    } else {
+        memset(out, 0, sizeof(*out));
+    }
+}
+
+/*
+ * Short name of a stage
+ */
+const char* latency_stage_name(int stage) {
+    if (stage >= 0 && stage < LATENCY_STAGES) {
+        return stage_names[stage];
+    }
+    return "?";
+}
+
+/*
+ * Clear all statistics
+ */
+void latency_reset(void) {
+    memset(stats, 0, sizeof(stats));
+    pending_count = 0;
+}
@@ -1,115 +1,285 @@
 #include "../include/mouse.h"
-#include "../include/io.h"
-#include "../include/pic.h"
+#include "../include/cursor.h"
+#include "../include/cpu.h"
+#include "../include/graphics.h"
+#include "../include/i8042.h"
+#include "../include/input.h"
+#include "../include/keyboard.h"
 
 static mouse_state_t mouse;
 static uint8_t mouse_cycle = 0;
-static int8_t mouse_bytes[3];
-
-// Default screen bounds (can be updated if graphics mode is available)
-static int screen_width = 800;
-static int screen_height = 600;
-
-// Wait for mouse controller
-static void mouse_wait(uint8_t type) {
-    uint32_t timeout = 100000;
-    if (type == 0) {
-        // Wait for bit 0 (output buffer full)
-        while (timeout--) {
-            if (inb(0x64) & 1) return;
+static uint8_t mouse_bytes[MOUSE_MAX_PACKET];
+
+// Device setup
+static int has_wheel = 0;
+static int packet_size = 3;
+static int sample_rate = MOUSE_DEFAULT_RATE;
+static int resolution = MOUSE_DEFAULT_RESOLUTION;
+
+// Motion decoded but not yet queued as an event (see mouse_flush_motion)
+static int motion_pending = 0;
+static uint64_t motion_tsc = 0;
+
+// Screen bounds - taken from the framebuffer, updated on mode switches
+// The defaults only apply without a framebuffer (text mode)
+#define MOUSE_DEFAULT_WIDTH  800
+#define MOUSE_DEFAULT_HEIGHT 600
+static int screen_width = MOUSE_DEFAULT_WIDTH;
+static int screen_height = MOUSE_DEFAULT_HEIGHT;
+
+// Command timeouts - reset runs the device self-test, which is slow
+#define MOUSE_RESET_TIMEOUT_MS 1000
+#define MOUSE_CMD_TIMEOUT_MS   100
+
+// Device commands and replies
+#define MOUSE_CMD_SET_RESOLUTION  0xE8
+#define MOUSE_CMD_GET_ID          0xF2
+#define MOUSE_CMD_SET_RATE        0xF3
+#define MOUSE_CMD_ENABLE          0xF4
+#define MOUSE_CMD_DISABLE         0xF5
+#define MOUSE_CMD_DEFAULTS        0xF6
+#define MOUSE_CMD_RESET           0xFF
+#define MOUSE_ID_WHEEL            3
+
+// Packet byte 0 flags
+#define MOUSE_PACKET_SYNC         0x08
+#define MOUSE_PACKET_X_SIGN       0x10
+#define MOUSE_PACKET_Y_SIGN       0x20
+#define MOUSE_PACKET_OVERFLOW     0xC0
+
+// Set once the device has answered its whole setup sequence
+static volatile int present = 0;
+
+// Check that a sample rate is one the PS/2 protocol allows
+static int mouse_rate_valid(int hz) {
+    switch (hz) {
+        case 10: case 20: case 40: case 60: case 80: case 100: case 200:
+            return 1;
+    }
+    return 0;
+}
+
+// Resolution in counts/mm (1, 2, 4, 8) to its command argument, -1 if invalid
+static int mouse_resolution_code(int counts_per_mm) {
+    switch (counts_per_mm) {
+        case 1: return 0;
+        case 2: return 1;
+        case 4: return 2;
+        case 8: return 3;
+    }
+    return -1;
+}
+
+// Queue a pointer event with the current position and buttons
+static void mouse_emit(uint8_t type, uint8_t changed, int wheel, uint64_t tsc) {
+    input_event_t event = {0};
+    event.tsc = tsc;
+    event.type = type;
+    event.modifiers = keyboard_get_modifiers();
+    event.buttons = mouse.buttons;
+    event.changed = changed;
+    event.x = mouse.x;
+    event.y = mouse.y;
+    event.wheel = wheel;
+    input_push(&event);
+}
+
+// Queue the motion accumulated so far as a single move event
+// Packets are coalesced until a button or wheel event needs ordering
+// against them, or the bottom half runs out of bytes. The event keeps
+// the timestamp of the oldest packet it covers.
+static void mouse_flush_motion(void) {
+    if (!motion_pending) return;
+    motion_pending = 0;
+
+    // Move the cursor overlay right away - no repaint needed
+    cursor_move(mouse.x, mouse.y);
+    mouse_emit(INPUT_MOUSE_MOVE, 0, 0, motion_tsc);
+}
+
+// Apply one complete packet
+static void mouse_process_packet(uint64_t tsc) {
+    uint8_t flags = mouse_bytes[0];
+    uint8_t buttons = flags & 0x07;
+
+    // Overflowed deltas are garbage - keep only the buttons
+    if (!(flags & MOUSE_PACKET_OVERFLOW)) {
+        // 9-bit two's complement deltas
+        int dx = mouse_bytes[1];
+        if (flags & MOUSE_PACKET_X_SIGN) dx -= 0x100;
+        int dy = mouse_bytes[2];
+        if (flags & MOUSE_PACKET_Y_SIGN) dy -= 0x100;
+
+        int old_x = mouse.x;
+        int old_y = mouse.y;
+        mouse.x += dx;
+        mouse.y -= dy;  // Invert Y
+
+        // Clamp to screen bounds
+        if (mouse.x < 0) mouse.x = 0;
+        if (mouse.y < 0) mouse.y = 0;
+        if (mouse.x >= screen_width) mouse.x = screen_width - 1;
+        if (mouse.y >= screen_height) mouse.y = screen_height - 1;
+
+        if ((mouse.x != old_x || mouse.y != old_y) && !motion_pending) {
+            motion_pending = 1;
+            motion_tsc = tsc;
         }
-    } else {
-        // Wait for bit 1 clear (input buffer empty)
-        while (timeout--) {
-            if (!(inb(0x64) & 2)) return;
+    }
+
+    // Motion first, so a click lands where the pointer ended up
+    if (buttons != mouse.buttons) {
+        mouse_flush_motion();
+        uint8_t changed = buttons ^ mouse.buttons;
+        mouse.buttons = buttons;
+        mouse_emit(INPUT_MOUSE_BUTTON, changed, 0, tsc);
+    }
+
+    // Wheel: low nibble of the fourth byte, signed (positive = towards user)
+    if (has_wheel) {
+        int dz = mouse_bytes[3] & 0x0F;
+        if (dz & 0x08) dz -= 0x10;
+        if (dz) {
+            mouse_flush_motion();
+            mouse_emit(INPUT_MOUSE_WHEEL, 0, dz, tsc);
         }
     }
 }
 
-static void mouse_write(uint8_t data) {
-    mouse_wait(1);
-    outb(0x64, 0xD4);  // Tell controller we're sending to mouse
-    mouse_wait(1);
-    outb(0x60, data);
+// Assemble packets from the byte stream
+static void mouse_decode(uint8_t data, uint64_t tsc) {
+    // Valid first byte has bit 3 set - resynchronize on anything else
+    if (mouse_cycle == 0 && !(data & MOUSE_PACKET_SYNC)) {
+        return;
+    }
+
+    mouse_bytes[mouse_cycle++] = data;
+    if (mouse_cycle == packet_size) {
+        mouse_cycle = 0;
+        mouse_process_packet(tsc);
+    }
+}
+
+// Queue a command for the mouse (completes in the PS/2 softirq)
+static void mouse_command(uint8_t command, i8042_done_t done) {
+    i8042_command1(I8042_PORT_AUX, command, MOUSE_CMD_TIMEOUT_MS, done, 0);
+}
+
+static void mouse_command_arg(uint8_t command, uint8_t arg) {
+    i8042_command2(I8042_PORT_AUX, command, arg, MOUSE_CMD_TIMEOUT_MS, 0, 0);
+}
+
+// Reply to the ID query: a wheel mouse reports 3 and sends 4-byte packets
+static void mouse_id_done(int port, int status, const uint8_t* reply, void* ctx) {
+    (void)port;
+    (void)ctx;
+    if (status == I8042_OK) {
+        has_wheel = reply[0] == MOUSE_ID_WHEEL;
+        packet_size = has_wheel ? 4 : 3;
+    }
+}
+
+// Streaming (re)started - begin on a packet boundary
+static void mouse_enable_done(int port, int status, const uint8_t* reply, void* ctx) {
+    (void)port;
+    (void)reply;
+    (void)ctx;
+    if (status == I8042_OK) {
+        mouse_cycle = 0;
+        present = 1;
+    }
+}
+
+// Queue the sample rate and resolution commands
+static void mouse_queue_config(void) {
+    mouse_command_arg(MOUSE_CMD_SET_RATE, sample_rate);
+    mouse_command_arg(MOUSE_CMD_SET_RESOLUTION, mouse_resolution_code(resolution));
 }
 
-static uint8_t mouse_read(void) {
-    mouse_wait(0);
-    return inb(0x60);
+// Streaming stopped - packet bytes sent before the DISABLE have all been
+// decoded by now, so drop the partial packet and reprogram the mouse.
+// Streaming is turned back on even if the DISABLE failed.
+static void mouse_disable_done(int port, int status, const uint8_t* reply, void* ctx) {
+    (void)port;
+    (void)reply;
+    (void)ctx;
+    if (status == I8042_OK) {
+        mouse_cycle = 0;
+        mouse_queue_config();
+    }
+    mouse_command(MOUSE_CMD_ENABLE, mouse_enable_done);
 }
 
+// Start the mouse without waiting for it
+// The whole setup sequence is queued at once and runs from interrupts;
+// if the device is missing, the reset times out and the rest is dropped.
 void mouse_init(void) {
+    if (graphics_is_available()) {
+        screen_width = graphics_get_width();
+        screen_height = graphics_get_height();
+    }
+
     // Initialize mouse position to center
     mouse.x = screen_width / 2;
     mouse.y = screen_height / 2;
     mouse.buttons = 0;
 
-    // Enable auxiliary device (mouse)
-    mouse_wait(1);
-    outb(0x64, 0xA8);
-
-    // Enable interrupts
-    mouse_wait(1);
-    outb(0x64, 0x20);  // Get compaq status
-    mouse_wait(0);
-    uint8_t status = inb(0x60) | 2;  // Enable IRQ12
-    mouse_wait(1);
-    outb(0x64, 0x60);  // Set compaq status
-    mouse_wait(1);
-    outb(0x60, status);
-
-    // Use default settings
-    mouse_write(0xF6);
-    mouse_read();  // ACK
-
-    // Enable mouse
-    mouse_write(0xF4);
-    mouse_read();  // ACK
-
-    // Enable IRQ12
-    pic_clear_mask(12);
-}
-
-void mouse_handler(void) {
-    uint8_t data = inb(0x60);
-
-    switch (mouse_cycle) {
-        case 0:
-            mouse_bytes[0] = data;
-            if (data & 0x08) {  // Valid first byte has bit 3 set
-                mouse_cycle++;
-            }
-            break;
-        case 1:
-            mouse_bytes[1] = data;
-            mouse_cycle++;
-            break;
-        case 2:
-            mouse_bytes[2] = data;
-            mouse_cycle = 0;
-
-            // Process packet
-            mouse.buttons = mouse_bytes[0] & 0x07;
-
-            // X movement (signed)
-            int dx = mouse_bytes[1];
-            if (mouse_bytes[0] & 0x10) dx |= 0xFFFFFF00;  // Sign extend
-
-            // Y movement (signed, inverted)
-            int dy = mouse_bytes[2];
-            if (mouse_bytes[0] & 0x20) dy |= 0xFFFFFF00;  // Sign extend
-
-            // Update position
-            mouse.x += dx;
-            mouse.y -= dy;  // Invert Y
-
-            // Clamp to screen bounds
-            if (mouse.x < 0) mouse.x = 0;
-            if (mouse.y < 0) mouse.y = 0;
-            if (mouse.x >= screen_width) mouse.x = screen_width - 1;
-            if (mouse.y >= screen_height) mouse.y = screen_height - 1;
-            break;
+    if (!i8042_port_present(I8042_PORT_AUX)) {
+        return;
     }
+    i8042_set_receiver(I8042_PORT_AUX, mouse_decode, mouse_flush_motion);
+
+    // Reset replies with the self-test result (0xAA) and the ID (0x00)
+    uint8_t reset = MOUSE_CMD_RESET;
+    i8042_command(I8042_PORT_AUX, &reset, 1, 2, MOUSE_RESET_TIMEOUT_MS, 0, 0);
+    mouse_command(MOUSE_CMD_DEFAULTS, 0);
+
+    // IntelliMouse handshake: sample rates 200, 100, 80, then read the ID
+    mouse_command_arg(MOUSE_CMD_SET_RATE, 200);
+    mouse_command_arg(MOUSE_CMD_SET_RATE, 100);
+    mouse_command_arg(MOUSE_CMD_SET_RATE, 80);
+    uint8_t get_id = MOUSE_CMD_GET_ID;
+    i8042_command(I8042_PORT_AUX, &get_id, 1, 1, MOUSE_CMD_TIMEOUT_MS, mouse_id_done, 0);
+
+    // The handshake left the rate at 80 Hz
+    mouse_queue_config();
+    mouse_command(MOUSE_CMD_ENABLE, mouse_enable_done);
+}
+
+// Change sample rate and/or resolution while the mouse is running
+// Pass 0 to keep a setting. Returns 0 if the change was queued, -1 for
+// invalid values or no mouse.
+int mouse_configure(int hz, int counts_per_mm) {
+    if (hz && !mouse_rate_valid(hz)) return -1;
+    if (counts_per_mm && mouse_resolution_code(counts_per_mm) < 0) return -1;
+    if (!present) return -1;
+
+    if (hz) sample_rate = hz;
+    if (counts_per_mm) resolution = counts_per_mm;
+
+    // Stop streaming first; the new settings follow once it is ACKed
+    mouse_command(MOUSE_CMD_DISABLE, mouse_disable_done);
+    return 0;
+}
+
+// Get the current settings
+void mouse_get_config(mouse_config_t* config) {
+    config->sample_rate = sample_rate;
+    config->resolution = resolution;
+    config->present = present;
+    config->has_wheel = has_wheel;
+    config->packet_size = packet_size;
+}
+
+// Change the area the pointer can move in (after a resolution switch)
+void mouse_set_bounds(int width, int height) {
+    uint32_t flags = cpu_irq_save();
+    screen_width = width;
+    screen_height = height;
+    if (mouse.x >= screen_width) mouse.x = screen_width - 1;
+    if (mouse.y >= screen_height) mouse.y = screen_height - 1;
+    cursor_move(mouse.x, mouse.y);
+    cpu_irq_restore(flags);
 }
 
 mouse_state_t mouse_get_state(void) { return mouse; }
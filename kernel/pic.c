@@ -47,6 +47,16 @@ void pic_init(void) {
     outb(PIC2_DATA, 0xFF);  /* 1111 1111 - all slave IRQs masked */
 }
 
+/**
+ * Mask every line on both PICs
+ * Used when the I/O APIC takes over interrupt delivery; the PICs stay
+ * remapped so a stray spurious interrupt cannot look like an exception.
+ */
+void pic_disable(void) {
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
+}
+
 /**
  * Send End of Interrupt (EOI) signal
  * For IRQs 8-15 (slave), we need to send EOI to both PICs
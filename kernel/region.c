@@ -0,0 +1,305 @@
+/*
+ * AJOS Region Library
+ * Union, intersection and subtraction of rectangle lists
+ */
+
+#include "../include/region.h"
+
+/*
+ * Build a rect from position and size
+ */
+rect_t rect_make(int x, int y, int width, int height) {
+    rect_t r = { x, y, x + width, y + height };
+    return r;
+}
+
+/*
+ * Check if a rect covers no pixels
+ */
+int rect_is_empty(const rect_t* r) {
+    return r->x1 >= r->x2 || r->y1 >= r->y2;
+}
+
+/*
+ * Intersect two rects
+ * Returns 1 and fills out if they overlap, 0 otherwise
+ */
+int rect_intersect(const rect_t* a, const rect_t* b, rect_t* out) {
+    rect_t r;
+    r.x1 = (a->x1 > b->x1) ? a->x1 : b->x1;
+    r.y1 = (a->y1 > b->y1) ? a->y1 : b->y1;
+    r.x2 = (a->x2 < b->x2) ? a->x2 : b->x2;
+    r.y2 = (a->y2 < b->y2) ? a->y2 : b->y2;
+
+    if (rect_is_empty(&r)) {
+        return 0;
+    }
+    if (out) {
+        *out = r;
+    }
+    return 1;
+}
+
+/*
+ * Split a into the parts not covered by b (up to 4 bands)
+ * Returns the number of pieces written
+ */
+static int rect_subtract(const rect_t* a, const rect_t* b, rect_t pieces[4]) {
+    rect_t overlap;
+    if (!rect_intersect(a, b, &overlap)) {
+        pieces[0] = *a;
+        return 1;
+    }
+
+    int n = 0;
+
+    /* Band above the overlap (full width) */
+    if (a->y1 < overlap.y1) {
+        pieces[n++] = (rect_t){ a->x1, a->y1, a->x2, overlap.y1 };
+    }
+    /* Band below the overlap (full width) */
+    if (overlap.y2 < a->y2) {
+        pieces[n++] = (rect_t){ a->x1, overlap.y2, a->x2, a->y2 };
+    }
+    /* Left and right of the overlap (overlap height) */
+    if (a->x1 < overlap.x1) {
+        pieces[n++] = (rect_t){ a->x1, overlap.y1, overlap.x1, overlap.y2 };
+    }
+    if (overlap.x2 < a->x2) {
+        pieces[n++] = (rect_t){ overlap.x2, overlap.y1, a->x2, overlap.y2 };
+    }
+
+    return n;
+}
+
+/*
+ * Make a region empty
+ */
+void region_clear(region_t* region) {
+    region->count = 0;
+}
+
+/*
+ * Make a region equal to a single rect
+ */
+void region_set_rect(region_t* region, const rect_t* rect) {
+    region->count = 0;
+    if (!rect_is_empty(rect)) {
+        region->rects[0] = *rect;
+        region->count = 1;
+    }
+}
+
+/*
+ * Copy a region
+ */
+void region_copy(region_t* dst, const region_t* src) {
+    dst->count = src->count;
+    for (int i = 0; i < src->count; i++) {
+        dst->rects[i] = src->rects[i];
+    }
+}
+
+/*
+ * Check if a region covers no pixels
+ */
+int region_is_empty(const region_t* region) {
+    return region->count == 0;
+}
+
+/*
+ * Get the bounding box of a region (empty rect if region is empty)
+ */
+rect_t region_bounds(const region_t* region) {
+    rect_t b = { 0, 0, 0, 0 };
+    if (region->count == 0) {
+        return b;
+    }
+
+    b = region->rects[0];
+    for (int i = 1; i < region->count; i++) {
+        const rect_t* r = &region->rects[i];
+        if (r->x1 < b.x1) b.x1 = r->x1;
+        if (r->y1 < b.y1) b.y1 = r->y1;
+        if (r->x2 > b.x2) b.x2 = r->x2;
+        if (r->y2 > b.y2) b.y2 = r->y2;
+    }
+    return b;
+}
+
+/*
+ * Replace a region with the bounding box of itself and rect (used on overflow)
+ */
+static void region_collapse(region_t* region, const rect_t* rect) {
+    rect_t b = *rect;
+    if (region->count > 0) {
+        rect_t r = region_bounds(region);
+        if (r.x1 < b.x1) b.x1 = r.x1;
+        if (r.y1 < b.y1) b.y1 = r.y1;
+        if (r.x2 > b.x2) b.x2 = r.x2;
+        if (r.y2 > b.y2) b.y2 = r.y2;
+    }
+    region_set_rect(region, &b);
+}
+
+/*
+ * Add a rect to a region
+ * Only the parts of rect not already covered are appended, so the
+ * rectangles stay disjoint. On overflow the region grows to a bounding
+ * box (grow) or the rect is dropped (!grow).
+ */
+static void region_add_rect(region_t* region, const rect_t* rect, int grow) {
+    if (rect_is_empty(rect)) {
+        return;
+    }
+
+    /* Cut the new rect down by every existing rect */
+    rect_t pieces[REGION_MAX_RECTS];
+    int count = 1;
+    pieces[0] = *rect;
+
+    for (int i = 0; i < region->count && count > 0; i++) {
+        rect_t next[REGION_MAX_RECTS];
+        int next_count = 0;
+
+        for (int j = 0; j < count; j++) {
+            rect_t split[4];
+            int n = rect_subtract(&pieces[j], &region->rects[i], split);
+            if (next_count + n > REGION_MAX_RECTS) {
+                /* Too fragmented - fall back to the bounding box */
+                if (grow) {
+                    region_collapse(region, rect);
+                }
+                return;
+            }
+            for (int k = 0; k < n; k++) {
+                next[next_count++] = split[k];
+            }
+        }
+
+        for (int j = 0; j < next_count; j++) {
+            pieces[j] = next[j];
+        }
+        count = next_count;
+    }
+
+    if (region->count + count > REGION_MAX_RECTS) {
+        if (grow) {
+            region_collapse(region, rect);
+        }
+        return;
+    }
+
+    for (int j = 0; j < count; j++) {
+        region->rects[region->count++] = pieces[j];
+    }
+}
+
+/*
+ * Add a rect to a region (covers at least the union on overflow)
+ */
+void region_union_rect(region_t* region, const rect_t* rect) {
+    region_add_rect(region, rect, 1);
+}
+
+/*
+ * Add a rect to a region (covers at most the union on overflow)
+ */
+void region_union_rect_inner(region_t* region, const rect_t* rect) {
+    region_add_rect(region, rect, 0);
+}
+
+/*
+ * Add another region to a region
+ */
+void region_union(region_t* region, const region_t* other) {
+    for (int i = 0; i < other->count; i++) {
+        region_union_rect(region, &other->rects[i]);
+    }
+}
+
+/*
+ * Remove a rect from a region
+ * If the result would not fit, the affected rect is kept whole, which
+ * over-approximates the true result.
+ */
+void region_subtract_rect(region_t* region, const rect_t* rect) {
+    if (rect_is_empty(rect)) {
+        return;
+    }
+
+    int i = 0;
+    while (i < region->count) {
+        rect_t a = region->rects[i];
+        if (!rect_intersect(&a, rect, 0)) {
+            i++;
+            continue;
+        }
+
+        rect_t split[4];
+        int n = rect_subtract(&a, rect, split);
+
+        if (region->count - 1 + n > REGION_MAX_RECTS) {
+            i++;    /* No room to split - keep it conservatively */
+            continue;
+        }
+
+        /* Remove a by moving the last rect into its slot */
+        region->rects[i] = region->rects[--region->count];
+
+        /* Append the pieces - they miss rect, so rescanning them is harmless */
+        for (int k = 0; k < n; k++) {
+            region->rects[region->count++] = split[k];
+        }
+
+        /* Slot i now holds an unchecked rect - look at it again */
+    }
+}
+
+/*
+ * Remove another region from a region
+ */
+void region_subtract(region_t* region, const region_t* other) {
+    for (int i = 0; i < other->count && region->count > 0; i++) {
+        region_subtract_rect(region, &other->rects[i]);
+    }
+}
+
+/*
+ * Clip a region to a rect
+ */
+void region_intersect_rect(region_t* region, const rect_t* rect) {
+    int n = 0;
+    for (int i = 0; i < region->count; i++) {
+        rect_t r;
+        if (rect_intersect(&region->rects[i], rect, &r)) {
+            region->rects[n++] = r;
+        }
+    }
+    region->count = n;
+}
+
+/*
+ * Intersect a region with another region
+ */
+void region_intersect(region_t* region, const region_t* other) {
+    region_t result;
+    result.count = 0;
+
+    for (int i = 0; i < region->count; i++) {
+        for (int j = 0; j < other->count; j++) {
+            rect_t r;
+            if (!rect_intersect(&region->rects[i], &other->rects[j], &r)) {
+                continue;
+            }
+            if (result.count == REGION_MAX_RECTS) {
+                /* Out of room - keep the (larger) original */
+                return;
+            }
+            /* Both inputs are disjoint, so the pieces are too */
+            result.rects[result.count++] = r;
+        }
+    }
+
+    region_copy(region, &result);
+}
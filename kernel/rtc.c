@@ -5,6 +5,8 @@
 
 #include "../include/rtc.h"
 #include "../include/io.h"
+#include "../include/irq.h"
+#include "../include/cpu.h"
 
 /* CMOS RTC ports */
 #define CMOS_ADDRESS 0x70
@@ -19,13 +21,37 @@
 #define RTC_YEAR     0x09
 #define RTC_STATUS_A 0x0A
 #define RTC_STATUS_B 0x0B
+#define RTC_STATUS_C 0x0C
+
+/* Status register B interrupt enable, reported back in register C */
+#define RTC_INT_UPDATE   0x10    /* Once per second, after the clock updates */
+
+/* Setting bit 7 of the address port keeps NMIs off while we talk to CMOS */
+#define CMOS_NMI_DISABLE 0x80
+
+/* Counter advanced by the RTC interrupt */
+static volatile uint32_t rtc_updates = 0;
 
 /*
  * Read a CMOS register
  */
 static uint8_t cmos_read(uint8_t reg) {
+    /* The interrupt handler also selects registers - keep the pair atomic */
+    uint32_t flags = cpu_irq_save();
     outb(CMOS_ADDRESS, reg);
-    return inb(CMOS_DATA);
+    uint8_t value = inb(CMOS_DATA);
+    cpu_irq_restore(flags);
+    return value;
+}
+
+/*
+ * Write a CMOS register
+ */
+static void cmos_write(uint8_t reg, uint8_t value) {
+    uint32_t flags = cpu_irq_save();
+    outb(CMOS_ADDRESS, CMOS_NMI_DISABLE | reg);
+    outb(CMOS_DATA, value);
+    cpu_irq_restore(flags);
 }
 
 /*
@@ -33,8 +59,7 @@ static uint8_t cmos_read(uint8_t reg) {
  * Returns 1 if update in progress, 0 otherwise
  */
 static int rtc_update_in_progress(void) {
-    outb(CMOS_ADDRESS, RTC_STATUS_A);
-    return (inb(CMOS_DATA) & 0x80);
+    return (cmos_read(RTC_STATUS_A) & 0x80);
 }
 
 /*
@@ -44,11 +69,47 @@ static uint8_t bcd_to_binary(uint8_t bcd) {
     return ((bcd & 0xF0) >> 4) * 10 + (bcd & 0x0F);
 }
 
+/*
+ * RTC interrupt handler (IRQ8)
+ * Register C must be read every time or the RTC stops interrupting
+ */
+static int rtc_handler(void* ctx) {
+    (void)ctx;
+    outb(CMOS_ADDRESS, RTC_STATUS_C);
+    uint8_t status_c = inb(CMOS_DATA);
+
+    if (status_c & RTC_INT_UPDATE) {
+        rtc_updates++;
+    }
+    return status_c ? IRQ_HANDLED : IRQ_NONE;
+}
+
 /*
  * Initialize RTC
+ * Turns on the once-a-second update interrupt, so the clock display can
+ * wait for the time to change instead of polling it.
  */
 void rtc_init(void) {
-    /* Nothing special needed for basic time reading */
+    uint32_t flags = cpu_irq_save();
+
+    uint8_t status_b = cmos_read(RTC_STATUS_B);
+    cmos_write(RTC_STATUS_B, status_b | RTC_INT_UPDATE);
+
+    /* Discard anything already latched so the next interrupt can fire */
+    cmos_read(RTC_STATUS_C);
+
+    cpu_irq_restore(flags);
+
+    irq_register(8, rtc_handler, 0);
+    irq_unmask(8);
+}
+
+/*
+ * Get the number of clock updates (seconds) seen since rtc_init()
+ * Changes exactly when the time of day read by rtc_get_time() does.
+ */
+uint32_t rtc_get_update_count(void) {
+    return rtc_updates;
 }
 
 /*
@@ -152,6 +152,12 @@ static void handle_input(char c) {
             vga_putchar(' ');
             vga_putchar('\b');
         }
+    } else if (c == KEY_CTRL('c')) {
+        /* Ctrl-C - discard the line */
+        vga_print("^C\n");
+        cmd_pos = 0;
+        cmd_buffer[0] = '\0';
+        print_prompt();
     } else if (c >= 32 && c < 127) {
         /* Printable character */
         if (cmd_pos < SHELL_MAX_CMD_LEN - 1) {
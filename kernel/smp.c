@@ -0,0 +1,186 @@
+/*
+ * AJOS SMP Bring-up
+ * Starts the application processors with INIT-SIPI-SIPI
+ */
+
+#include "smp.h"
+#include "acpi.h"
+#include "apic.h"
+#include "atomic.h"
+#include "clock.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "heap.h"
+#include "idt.h"
+#include "string.h"
+#include "taskpool.h"
+
+/* Delays from the MP specification's universal startup algorithm */
+#define AP_INIT_DELAY_US    10000
+#define AP_SIPI_DELAY_US    200
+#define AP_START_TIMEOUT_US 100000
+
+/* Trampoline blob and its parameter slots (boot/ap_trampoline.asm) */
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_boot_stack[];
+extern uint8_t ap_boot_entry[];
+extern uint8_t ap_boot_cpu[];
+
+/* Bootstrap CPU stack (boot.asm) */
+extern uint8_t stack_top[];
+
+static percpu_t cpus[SMP_MAX_CPUS];
+static int cpus_present = 1;
+static atomic_t cpus_online = ATOMIC_INIT(1);
+
+/*
+ * Load a CPU's GDT, TSS and GS from its per-CPU data
+ */
+static void percpu_load(percpu_t* cpu) {
+    gdt_init_cpu(cpu->index, (uint32_t)cpu, sizeof(*cpu), cpu->stack_top);
+}
+
+/*
+ * Set up the bootstrap CPU's per-CPU data and descriptor tables
+ * The APIC ID is filled in by smp_init() once the APIC is known.
+ */
+void smp_init_bsp(void) {
+    percpu_t* cpu = &cpus[0];
+
+    cpu->self = cpu;
+    cpu->index = 0;
+    cpu->stack_top = (uint32_t)stack_top;
+    cpu->online = 1;
+    percpu_load(cpu);
+}
+
+/*
+ * Get the low-memory copy of a trampoline parameter
+ */
+static volatile uint32_t* trampoline_param(uint8_t* symbol) {
+    return (volatile uint32_t*)(AP_TRAMPOLINE_BASE + (symbol - ap_trampoline_start));
+}
+
+/*
+ * C entry point of an application processor
+ * Called by the trampoline on the AP's own stack, in protected mode with
+ * the trampoline's temporary GDT.
+ */
+static void ap_main(uint32_t index) {
+    percpu_t* cpu = &cpus[index];
+
+    percpu_load(cpu);
+    idt_load();
+    cpu_init_ap();
+    apic_init_ap();
+
+    cpu->online = 1;
+    atomic_inc(&cpus_online);
+
+    /* Halt until the task pool has work */
+    taskpool_ap_main();
+}
+
+/*
+ * Wake one application processor and wait for it to come online
+ * Returns 0 on success, -1 if it did not start in time
+ */
+static int smp_start_ap(percpu_t* cpu) {
+    void* stack = kmalloc(SMP_AP_STACK_SIZE);
+    if (!stack) {
+        return -1;
+    }
+    cpu->stack_top = (uint32_t)stack + SMP_AP_STACK_SIZE;
+
+    *trampoline_param(ap_boot_stack) = cpu->stack_top;
+    *trampoline_param(ap_boot_entry) = (uint32_t)ap_main;
+    *trampoline_param(ap_boot_cpu) = cpu->index;
+    atomic_fence();
+
+    /* INIT, then up to two STARTUPs; a running AP ignores the second */
+    lapic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+    clock_delay_us(AP_INIT_DELAY_US);
+    for (int i = 0; i < 2 && !cpu->online; i++) {
+        lapic_send_ipi(cpu->apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE_BASE >> 12));
+        clock_delay_us(AP_SIPI_DELAY_US);
+    }
+
+    for (uint32_t waited = 0; !cpu->online; waited += 100) {
+        if (waited >= AP_START_TIMEOUT_US) {
+            /* The stack stays allocated - the AP may still wake up on it */
+            return -1;
+        }
+        clock_delay_us(100);
+    }
+    return 0;
+}
+
+/*
+ * Start every processor the MADT lists
+ * The trampoline goes to low memory, which only the multiboot info
+ * occupied (already consumed by heap_init() and graphics_init()).
+ */
+int smp_init(void) {
+    if (!apic_is_enabled() || !g_madt.valid) {
+        return 1;
+    }
+
+    uint8_t bsp_id = lapic_get_id();
+    cpus[0].apic_id = bsp_id;
+
+    for (int i = 0; i < g_madt.cpu_count && cpus_present < SMP_MAX_CPUS; i++) {
+        if (g_madt.cpu_apic_ids[i] == bsp_id) {
+            continue;
+        }
+        percpu_t* cpu = &cpus[cpus_present];
+        cpu->self = cpu;
+        cpu->index = cpus_present;
+        cpu->apic_id = g_madt.cpu_apic_ids[i];
+        cpu->online = 0;
+        cpus_present++;
+    }
+    if (cpus_present == 1) {
+        return 1;
+    }
+
+    memcpy((void*)AP_TRAMPOLINE_BASE, ap_trampoline_start,
+           ap_trampoline_end - ap_trampoline_start);
+
+    /*
+     * One AP at a time - they share the trampoline's parameter slots.
+     * A CPU that misses its deadline could still wake up later and read
+     * the next CPU's parameters, so stop at the first failure.
+     */
+    for (int i = 1; i < cpus_present; i++) {
+        if (smp_start_ap(&cpus[i]) != 0) {
+            break;
+        }
+    }
+
+    return atomic_load(&cpus_online);
+}
+
+/*
+ * Number of CPUs running
+ */
+int smp_cpu_count(void) {
+    return atomic_load(&cpus_online);
+}
+
+/*
+ * Number of CPUs known (online or not)
+ */
+int smp_cpu_present(void) {
+    return cpus_present;
+}
+
+/*
+ * Get a CPU's per-CPU data
+ */
+percpu_t* smp_get_cpu(int index) {
+    if (index < 0 || index >= cpus_present) {
+        return 0;
+    }
+    return &cpus[index];
+}
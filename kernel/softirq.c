@@ -0,0 +1,67 @@
+/*
+ * AJOS Softirqs
+ * Bottom halves run after the EOI with interrupts enabled
+ */
+
+#include "softirq.h"
+#include "smp.h"
+#include "timer.h"
+
+static softirq_fn_t handlers[SOFTIRQ_COUNT];
+
+/*
+ * Install the bottom half for a softirq number
+ */
+void softirq_register(int nr, softirq_fn_t fn) {
+    if (nr >= 0 && nr < SOFTIRQ_COUNT) {
+        handlers[nr] = fn;
+    }
+}
+
+/*
+ * Mark a softirq pending on this CPU
+ * Only this CPU touches its pending set, always with interrupts off.
+ */
+void softirq_raise(int nr) {
+    this_cpu()->softirq_pending |= 1u << nr;
+}
+
+/*
+ * Run pending softirqs with interrupts enabled
+ */
+void softirq_run(void) {
+    percpu_t* cpu = this_cpu();
+
+    if (cpu->in_softirq || !cpu->softirq_pending) {
+        return;
+    }
+    cpu->in_softirq = 1;
+
+    for (int pass = 0; pass < SOFTIRQ_MAX_RESTART && cpu->softirq_pending; pass++) {
+        uint32_t pending = cpu->softirq_pending;
+        cpu->softirq_pending = 0;
+
+        __asm__ volatile ("sti");
+        for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            if ((pending & (1u << nr)) && handlers[nr]) {
+                handlers[nr]();
+            }
+        }
+        __asm__ volatile ("cli");
+    }
+
+    /* Restart limit hit - make sure an interrupt comes back for the rest */
+    /* (an idle tickless system might not see another for a long time) */
+    if (cpu->softirq_pending) {
+        timer_wakeup_at(timer_uptime_ms() + 1);
+    }
+
+    cpu->in_softirq = 0;
+}
+
+/*
+ * Check whether this CPU is running softirqs
+ */
+int softirq_active(void) {
+    return this_cpu()->in_softirq;
+}
@@ -121,3 +121,53 @@ void *memcpy(void *dest, const void *src, size_t size) {
 
     return dest;
 }
+
+/*
+ * Compare two blocks of memory
+ * Returns: 0 if equal, <0 if s1 < s2, >0 if s1 > s2
+ */
+int memcmp(const void *s1, const void *s2, size_t size) {
+    const unsigned char *a = (const unsigned char *)s1;
+    const unsigned char *b = (const unsigned char *)s2;
+
+    while (size > 0) {
+        if (*a != *b) {
+            return *a - *b;
+        }
+        a++;
+        b++;
+        size--;
+    }
+
+    return 0;
+}
+
+/*
+ * Convert an unsigned integer to a null-terminated string
+ * buf must hold at least 33 bytes for base 2, 11 for base 10
+ * Returns: pointer to buf
+ */
+char *utoa(uint32_t value, char *buf, int base) {
+    static const char digits[] = "0123456789ABCDEF";
+    char tmp[33];
+    int len = 0;
+
+    if (base < 2 || base > 16) {
+        buf[0] = '\0';
+        return buf;
+    }
+
+    /* Generate digits least significant first */
+    do {
+        tmp[len++] = digits[value % base];
+        value /= base;
+    } while (value > 0);
+
+    /* Reverse into the output buffer */
+    for (int i = 0; i < len; i++) {
+        buf[i] = tmp[len - 1 - i];
+    }
+    buf[len] = '\0';
+
+    return buf;
+}
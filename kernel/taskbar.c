@@ -35,6 +35,7 @@
 /* Taskbar state */
 static int taskbar_y = 0;
 static int screen_w = 0;
+static uint32_t drawn_second = 0xFFFFFFFF;   /* RTC update count last shown */
 
 /* External terminal reference for creating new terminals */
 extern terminal_t* terminal_create(int x, int y);
@@ -69,6 +70,13 @@ static void draw_button(int x, int y, int w, int h, color_t bg_color, int presse
     }
 }
 
+/*
+ * Check whether the taskbar shows stale information (the clock ticked)
+ */
+int taskbar_needs_redraw(void) {
+    return rtc_get_update_count() != drawn_second;
+}
+
 /*
  * Draw the taskbar
  */
@@ -99,6 +107,7 @@ void taskbar_draw(void) {
 
     /* Get current time from RTC */
     rtc_time_t time;
+    drawn_second = rtc_get_update_count();
     rtc_get_time(&time);
 
     /* Apply timezone offset: Eastern Time (UTC-5) */
@@ -0,0 +1,170 @@
+/*
+ * AJOS Task Pool
+ * Per-CPU work-stealing deques for data-parallel batches
+ */
+
+#include "taskpool.h"
+#include "apic.h"
+#include "atomic.h"
+#include "gdt.h"
+#include "idt.h"
+#include "smp.h"
+#include "spinlock.h"
+
+/* Tasks of the current batch queued on one CPU */
+typedef struct {
+    spinlock_t lock;
+    int top;        /* Thieves take from here */
+    int bottom;     /* The owner takes from here (exclusive) */
+    uint16_t tasks[TASKPOOL_DEQUE_SIZE];
+} deque_t;
+
+static deque_t deques[SMP_MAX_CPUS];
+static int ready = 0;
+
+/* Current batch - written only while no batch is active */
+static task_fn_t job_fn = 0;
+static void* job_arg = 0;
+static int job_base = 0;        /* Deques hold indices relative to this */
+static atomic_t job_remaining = ATOMIC_INIT(0);    /* Tasks not yet finished */
+static atomic_t job_active = ATOMIC_INIT(0);
+
+/*
+ * Take the owner's most recently queued task
+ */
+static int deque_pop(deque_t* dq, int* task) {
+    int found = 0;
+    uint32_t flags = spin_lock_irqsave(&dq->lock);
+    if (dq->bottom > dq->top) {
+        *task = dq->tasks[--dq->bottom];
+        found = 1;
+    }
+    spin_unlock_irqrestore(&dq->lock, flags);
+    return found;
+}
+
+/*
+ * Take the oldest task from another CPU's deque
+ */
+static int deque_steal(deque_t* dq, int* task) {
+    int found = 0;
+    uint32_t flags = spin_lock_irqsave(&dq->lock);
+    if (dq->bottom > dq->top) {
+        *task = dq->tasks[dq->top++];
+        found = 1;
+    }
+    spin_unlock_irqrestore(&dq->lock, flags);
+    return found;
+}
+
+/*
+ * Run tasks until none are left to take
+ * Own deque first, then steal round-robin starting at the next CPU.
+ */
+static void taskpool_work(void) {
+    percpu_t* cpu = this_cpu();
+    int self = cpu->index;
+    int ncpus = smp_cpu_present();
+    int task;
+
+    while (atomic_load(&job_remaining) != 0) {
+        int found = deque_pop(&deques[self], &task);
+        for (int i = 1; !found && i < ncpus; i++) {
+            found = deque_steal(&deques[(self + i) % ncpus], &task);
+        }
+        if (!found) {
+            return;     /* Everything is taken; others are finishing up */
+        }
+
+        job_fn(job_arg, job_base + task);
+        cpu->tasks_run++;
+        atomic_dec(&job_remaining);
+    }
+}
+
+/*
+ * Install the wakeup IPI
+ */
+void taskpool_init(void) {
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        spin_lock_init(&deques[i].lock);
+    }
+    idt_set_gate(TASKPOOL_WAKE_VECTOR, (uint32_t)taskpool_wake_stub,
+                 KERNEL_CODE_SEG, IDT_INTERRUPT_GATE);
+    ready = 1;
+}
+
+/*
+ * Run a batch on all CPUs, including the caller
+ */
+void taskpool_run(task_fn_t fn, void* arg, int count) {
+    int ncpus = smp_cpu_count();
+
+    if (!ready || ncpus < 2 || count < TASKPOOL_MIN_PARALLEL) {
+        for (int i = 0; i < count; i++) {
+            fn(arg, i);
+        }
+        return;
+    }
+
+    /* Online CPUs are 0 .. ncpus-1 (bring-up stops at the first failure) */
+    int start = 0;
+    while (start < count) {
+        int batch = count - start;
+        if (batch > ncpus * TASKPOOL_DEQUE_SIZE) {
+            batch = ncpus * TASKPOOL_DEQUE_SIZE;
+        }
+
+        /*
+         * Publish the batch before queueing its tasks: a CPU still looping
+         * in taskpool_work() may take one the moment it is queued.
+         */
+        job_fn = fn;
+        job_arg = arg;
+        job_base = start;
+        atomic_store(&job_remaining, batch);
+
+        /* Contiguous chunks, queued so each owner pops its chunk in order */
+        for (int c = 0; c < ncpus; c++) {
+            deque_t* dq = &deques[c];
+            int first = batch * c / ncpus;
+            int last = batch * (c + 1) / ncpus;
+
+            uint32_t flags = spin_lock_irqsave(&dq->lock);
+            dq->top = 0;
+            dq->bottom = 0;
+            for (int t = last - 1; t >= first; t--) {
+                dq->tasks[dq->bottom++] = t;
+            }
+            spin_unlock_irqrestore(&dq->lock, flags);
+        }
+
+        atomic_store(&job_active, 1);
+        lapic_send_ipi(0, LAPIC_ICR_ALL_BUT_SELF | TASKPOOL_WAKE_VECTOR);
+
+        taskpool_work();
+        while (atomic_load(&job_remaining) != 0) {
+            cpu_relax();
+        }
+        atomic_store(&job_active, 0);
+
+        start += batch;
+    }
+}
+
+/*
+ * Application processor loop: halt until a batch is posted, help run it
+ * Interrupts stay off between the check and hlt, so a wakeup IPI cannot
+ * be lost.
+ */
+void taskpool_ap_main(void) {
+    while (1) {
+        __asm__ volatile ("cli");
+        if (!atomic_load(&job_active)) {
+            __asm__ volatile ("sti; hlt");
+            continue;
+        }
+        __asm__ volatile ("sti");
+        taskpool_work();
+    }
+}
@@ -9,18 +9,42 @@
 #include "font.h"
 #include "string.h"
 #include "keyboard.h"
+#include "input.h"
+#include "desktop.h"
+#include "smp.h"
+#include "cpu.h"
+#include "timer.h"
+#include "clock.h"
+#include "irq.h"
+#include "mouse.h"
+#include "latency.h"
 
 /* Terminal colors */
 #define TERM_BG_COLOR   COLOR_BLACK
 #define TERM_FG_COLOR   RGB(192, 192, 192)  /* Light gray text */
 #define TERM_PROMPT_COLOR RGB(0, 255, 0)    /* Green prompt */
 
+/* How often a sleeping command looks for Ctrl-C */
+#define TERMINAL_POLL_MS 20
+
 /* Global terminal instance (for callback access) */
 static terminal_t* g_terminal = 0;
 
+/* Runs commands so a slow one does not stall input and rendering */
+static thread_t* shell_thread = 0;
+
 /* Forward declarations for command processing */
 static void terminal_process_command(terminal_t* term);
 static void terminal_show_prompt(terminal_t* term);
+static void terminal_cmd_blitbench(terminal_t* term);
+static void terminal_cmd_mode(terminal_t* term, const char* args);
+static void terminal_cmd_fps(terminal_t* term, const char* args);
+static void terminal_cmd_mouse(terminal_t* term, const char* args);
+static void terminal_cmd_cpus(terminal_t* term);
+static void terminal_cmd_sleep(terminal_t* term, const char* args);
+static void terminal_cmd_irqstat(terminal_t* term);
+static void terminal_cmd_latency(terminal_t* term, const char* args);
+static void terminal_shell_main(void* arg);
 
 /*
  * Draw callback for the terminal window
@@ -35,13 +59,38 @@ static void terminal_draw_callback(window_t* win) {
 /*
  * Key callback for the terminal window
  */
-static void terminal_key_callback(window_t* win, unsigned char key) {
+static void terminal_key_callback(window_t* win, unsigned char key, uint8_t modifiers) {
     if (!g_terminal || g_terminal->window != win) {
         return;
     }
+
+    /* Shift+PgUp/PgDn page through the scrollback */
+    if ((modifiers & INPUT_MOD_SHIFT) && (key == KEY_PAGE_UP || key == KEY_PAGE_DOWN)) {
+        int page = TERM_ROWS - 1;
+        terminal_scroll_view(g_terminal, key == KEY_PAGE_UP ? page : -page);
+        return;
+    }
     terminal_handle_key(g_terminal, key);
 }
 
+/*
+ * Wheel callback for the terminal window
+ */
+static void terminal_wheel_callback(window_t* win, int delta) {
+    if (!g_terminal || g_terminal->window != win) {
+        return;
+    }
+    /* Towards the user moves forward, to newer lines */
+    terminal_scroll_view(g_terminal, -delta * TERM_WHEEL_LINES);
+}
+
+/*
+ * Row of the ring for a screen row (negative rows are scrollback)
+ */
+static char* terminal_row(terminal_t* term, int row) {
+    return term->lines[(term->top + row + TERM_LINES) % TERM_LINES];
+}
+
 /*
  * Create a new terminal window
  */
@@ -50,6 +99,19 @@ terminal_t* terminal_create(int x, int y) {
     static terminal_t term_storage;
     terminal_t* term = &term_storage;
 
+    /* One terminal state and one shell thread - never reset them under */
+    /* a running command or an open window */
+    if (g_terminal) {
+        window_t* win = g_terminal->window;
+        if (win && win->visible && win->draw_content == terminal_draw_callback) {
+            wm_focus_window(win);
+            return g_terminal;
+        }
+        if (g_terminal->busy) {
+            return 0;
+        }
+    }
+
     /* Calculate window size based on terminal dimensions */
     /* Add padding for borders and some margin */
     int char_width = font_get_width();
@@ -73,6 +135,7 @@ terminal_t* terminal_create(int x, int y) {
     /* Set callbacks */
     term->window->draw_content = terminal_draw_callback;
     term->window->on_key = terminal_key_callback;
+    term->window->on_wheel = terminal_wheel_callback;
 
     /* Initialize terminal state */
     term->cursor_row = 0;
@@ -92,16 +155,25 @@ terminal_t* terminal_create(int x, int y) {
     }
 
     /* Clear buffer */
-    for (int row = 0; row < TERM_ROWS; row++) {
-        for (int col = 0; col <= TERM_COLS; col++) {
-            term->buffer[row][col] = '\0';
-        }
-    }
+    memset(term->lines, 0, sizeof(term->lines));
+    term->top = 0;
+    term->scrollback = 0;
+    term->view_offset = 0;
     memset(term->input_line, 0, sizeof(term->input_line));
+    term->busy = 0;
+    term->typeahead_head = 0;
+    term->typeahead_count = 0;
 
     /* Store global reference */
     g_terminal = term;
 
+    /* Commands execute on their own thread */
+    if (!shell_thread) {
+        term->command_queue.head = 0;
+        term->command_queue.tail = 0;
+        shell_thread = thread_create("shell", terminal_shell_main, term);
+    }
+
     /* Show welcome message and prompt */
     terminal_print(term, "AJOS Terminal v0.1\n");
     terminal_print(term, "Type 'aj help' for commands.\n\n");
@@ -128,32 +200,52 @@ void terminal_destroy(terminal_t* term) {
 
 /*
  * Scroll the terminal buffer up by one line
+ * The top row becomes scrollback; the row after the screen is the
+ * oldest scrollback line, reused as the new bottom row.
  */
 void terminal_scroll(terminal_t* term) {
     if (!term) return;
 
-    /* Move all lines up by one */
-    for (int row = 0; row < TERM_ROWS - 1; row++) {
-        for (int col = 0; col <= TERM_COLS; col++) {
-            term->buffer[row][col] = term->buffer[row + 1][col];
-        }
+    memset(terminal_row(term, TERM_ROWS), 0, TERM_COLS);
+    term->top = (term->top + 1) % TERM_LINES;
+    if (term->scrollback < TERM_SCROLLBACK) {
+        term->scrollback++;
     }
 
-    /* Clear the last line */
-    for (int col = 0; col <= TERM_COLS; col++) {
-        term->buffer[TERM_ROWS - 1][col] = '\0';
+    /* A view into the scrollback stays on the same text */
+    if (term->view_offset > 0 && term->view_offset < term->scrollback) {
+        term->view_offset++;
     }
 }
 
 /*
- * Put a character to the terminal buffer
+ * Move the view through the scrollback (lines > 0 goes back)
  */
-void terminal_putchar(terminal_t* term, char c) {
+void terminal_scroll_view(terminal_t* term, int lines) {
     if (!term) return;
 
+    desktop_lock();
+    int offset = term->view_offset + lines;
+    if (offset > term->scrollback) offset = term->scrollback;
+    if (offset < 0) offset = 0;
+    if (offset != term->view_offset) {
+        term->view_offset = offset;
+        wm_invalidate(term->window);
+    }
+    desktop_unlock();
+}
+
+/*
+ * Put a character to the terminal buffer (desktop lock held)
+ */
+static void terminal_put(terminal_t* term, char c) {
+    char* line = terminal_row(term, term->cursor_row);
+
     if (c == '\n') {
         /* Newline - move to start of next line */
-        term->buffer[term->cursor_row][term->cursor_col] = '\0';
+        if (term->cursor_col < TERM_COLS) {
+            line[term->cursor_col] = '\0';
+        }
         term->cursor_col = 0;
         term->cursor_row++;
 
@@ -168,19 +260,19 @@ void terminal_putchar(terminal_t* term, char c) {
         /* Backspace - move back one character */
         if (term->cursor_col > 0) {
             term->cursor_col--;
-            term->buffer[term->cursor_row][term->cursor_col] = ' ';
+            line[term->cursor_col] = ' ';
         }
     } else if (c == '\t') {
         /* Tab - move to next 4-character boundary */
         int next_tab = ((term->cursor_col / 4) + 1) * 4;
         while (term->cursor_col < next_tab && term->cursor_col < TERM_COLS) {
-            term->buffer[term->cursor_row][term->cursor_col] = ' ';
+            line[term->cursor_col] = ' ';
             term->cursor_col++;
         }
     } else if (c >= 32 && c < 127) {
         /* Printable character */
         if (term->cursor_col < TERM_COLS) {
-            term->buffer[term->cursor_row][term->cursor_col] = c;
+            line[term->cursor_col] = c;
             term->cursor_col++;
 
             /* Wrap to next line if at end */
@@ -196,16 +288,34 @@ void terminal_putchar(terminal_t* term, char c) {
     }
 }
 
+/*
+ * Put a character to the terminal buffer
+ */
+void terminal_putchar(terminal_t* term, char c) {
+    if (!term) return;
+
+    desktop_lock();
+    terminal_put(term, c);
+    /* Contents change - window surface needs re-rendering */
+    wm_invalidate(term->window);
+    desktop_unlock();
+}
+
 /*
  * Print a string to the terminal
  */
 void terminal_print(terminal_t* term, const char* str) {
     if (!term || !str) return;
 
+    /* One lock for the whole string, so it appears in a single frame */
+    /* and the desktop is woken once */
+    desktop_lock();
     while (*str) {
-        terminal_putchar(term, *str);
+        terminal_put(term, *str);
         str++;
     }
+    wm_invalidate(term->window);
+    desktop_unlock();
 }
 
 /*
@@ -214,16 +324,20 @@ void terminal_print(terminal_t* term, const char* str) {
 void terminal_clear(terminal_t* term) {
     if (!term) return;
 
-    /* Clear all buffer contents */
+    desktop_lock();
+
+    /* Clear the screen rows; the scrollback is kept */
     for (int row = 0; row < TERM_ROWS; row++) {
-        for (int col = 0; col <= TERM_COLS; col++) {
-            term->buffer[row][col] = '\0';
-        }
+        memset(terminal_row(term, row), 0, TERM_COLS);
     }
 
-    /* Reset cursor */
+    /* Reset cursor and view */
     term->cursor_row = 0;
     term->cursor_col = 0;
+    term->view_offset = 0;
+
+    wm_invalidate(term->window);
+    desktop_unlock();
 }
 
 /*
@@ -251,8 +365,9 @@ void terminal_draw(terminal_t* term) {
 
     /* Draw each character in the buffer (only visible portion) */
     for (int row = 0; row < visible_rows; row++) {
+        const char* line = terminal_row(term, row - term->view_offset);
         for (int col = 0; col < visible_cols; col++) {
-            char c = term->buffer[row][col];
+            char c = line[col];
             if (c == '\0') {
                 /* Draw space for empty cells */
                 c = ' ';
@@ -265,10 +380,11 @@ void terminal_draw(terminal_t* term) {
         }
     }
 
-    /* Draw cursor if visible */
-    if (term->cursor_col < visible_cols && term->cursor_row < visible_rows) {
+    /* Draw cursor if visible (it moves down when scrolled back) */
+    int cursor_row = term->cursor_row + term->view_offset;
+    if (term->cursor_col < visible_cols && cursor_row < visible_rows) {
         int cursor_x = base_x + term->cursor_col * char_width;
-        int cursor_y = base_y + term->cursor_row * char_height;
+        int cursor_y = base_y + cursor_row * char_height;
         draw_filled_rect(cursor_x, cursor_y, char_width, char_height, term->fg_color);
     }
 }
@@ -280,17 +396,346 @@ static void terminal_show_prompt(terminal_t* term) {
     terminal_print(term, "AJOS> ");
 }
 
+/*
+ * Print an unsigned decimal number
+ */
+static void terminal_print_uint(terminal_t* term, uint32_t value) {
+    char buf[12];
+    terminal_print(term, utoa(value, buf, 10));
+}
+
+/*
+ * Print a string padded with spaces to width (right-aligned if right)
+ * Built up front so the whole field is one terminal write.
+ */
+static void terminal_print_padded(terminal_t* term, const char* str, int width, int right) {
+    char buf[64];
+    int len = strlen(str);
+    int pad = width > len ? width - len : 0;
+    if (len + pad >= (int)sizeof(buf)) {
+        terminal_print(term, str);
+        return;
+    }
+
+    char* p = buf;
+    if (right) {
+        memset(p, ' ', pad);
+        p += pad;
+    }
+    memcpy(p, str, len);
+    p += len;
+    if (!right) {
+        memset(p, ' ', pad);
+        p += pad;
+    }
+    *p = '\0';
+    terminal_print(term, buf);
+}
+
+/*
+ * Print an unsigned number right-aligned in a field
+ */
+static void terminal_print_field(terminal_t* term, uint32_t value, int width) {
+    char buf[12];
+    terminal_print_padded(term, utoa(value, buf, 10), width, 1);
+}
+
+/*
+ * Check for Ctrl-C during a command
+ * Long-running commands call this between steps and stop when it
+ * returns non-zero.
+ */
+static int terminal_check_interrupt(terminal_t* term) {
+    if (!term->interrupted) {
+        return 0;
+    }
+    terminal_print(term, "^C\n");
+    return 1;
+}
+
+/*
+ * aj blitbench - measure present throughput of each row copy kernel
+ */
+static void terminal_cmd_blitbench(terminal_t* term) {
+    terminal_print(term, "Blitter   MB/s\n");
+    for (int i = 0; i < GRAPHICS_BLITTER_COUNT; i++) {
+        if (terminal_check_interrupt(term)) {
+            return;
+        }
+        const char* name = graphics_blitter_name(i);
+        terminal_print(term, (i == graphics_get_blitter()) ? "* " : "  ");
+        terminal_print_padded(term, name, 8, 0);
+
+        if (!graphics_blitter_available(i)) {
+            terminal_print(term, "n/a\n");
+            continue;
+        }
+        /* Keep the desktop off the screen while it is being measured */
+        desktop_lock();
+        uint32_t mbps = graphics_benchmark_blitter(i);
+        desktop_unlock();
+        terminal_print_uint(term, mbps);
+        terminal_print(term, "\n");
+    }
+}
+
+/*
+ * Parse an unsigned decimal number, advancing *s past it
+ * Returns -1 if *s does not start with a digit
+ */
+static int terminal_parse_uint(const char** s) {
+    const char* p = *s;
+    int value = 0;
+
+    if (*p < '0' || *p > '9') return -1;
+    while (*p >= '0' && *p <= '9' && value < 100000) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    *s = p;
+    return value;
+}
+
+/*
+ * aj mode [WxH] - show or change the screen resolution
+ */
+static void terminal_cmd_mode(terminal_t* term, const char* args) {
+    if (*args == '\0') {
+        terminal_print(term, "Current mode: ");
+        terminal_print_uint(term, graphics_get_width());
+        terminal_putchar(term, 'x');
+        terminal_print_uint(term, graphics_get_height());
+        terminal_print(term, "x32\n");
+        terminal_print(term, "Present: ");
+        terminal_print(term, graphics_buffer_age() > 1 ? "page flip\n" : "copy\n");
+        if (graphics_can_set_mode()) {
+            terminal_print(term, "Try: aj mode 800x600, 1024x768, 1280x1024\n");
+        } else {
+            terminal_print(term, "Mode switching needs a Bochs/QEMU display adapter\n");
+        }
+        return;
+    }
+
+    int width = terminal_parse_uint(&args);
+    int height = -1;
+    if (width > 0 && (*args == 'x' || *args == 'X')) {
+        args++;
+        height = terminal_parse_uint(&args);
+    }
+    if (width < 640 || height < 480 || *args != '\0') {
+        terminal_print(term, "Usage: aj mode <width>x<height> (at least 640x480)\n");
+        return;
+    }
+
+    if (desktop_set_resolution(width, height) != 0) {
+        terminal_print(term, "Mode not supported\n");
+        return;
+    }
+    terminal_print(term, "Switched to ");
+    terminal_print_uint(term, width);
+    terminal_putchar(term, 'x');
+    terminal_print_uint(term, height);
+    terminal_print(term, "\n");
+}
+
+/*
+ * aj fps [N] - show or change the desktop's target frame rate
+ */
+static void terminal_cmd_fps(terminal_t* term, const char* args) {
+    if (*args != '\0') {
+        int fps = terminal_parse_uint(&args);
+        if (fps < 1 || *args != '\0') {
+            terminal_print(term, "Usage: aj fps <frames per second>\n");
+            return;
+        }
+        desktop_set_frame_rate(fps);
+    }
+    terminal_print(term, "Target frame rate: ");
+    terminal_print_uint(term, desktop_get_frame_rate());
+    terminal_print(term, " fps\n");
+}
+
+/*
+ * aj mouse [hz [counts/mm]] - show or set the mouse sample rate and resolution
+ */
+static void terminal_cmd_mouse(terminal_t* term, const char* args) {
+    if (*args != '\0') {
+        int hz = terminal_parse_uint(&args);
+        int res = 0;
+        if (*args == ' ') {
+            args++;
+            res = terminal_parse_uint(&args);
+        }
+        if (hz < 1 || res < 0 || *args != '\0' || mouse_configure(hz, res) != 0) {
+            terminal_print(term, "Usage: aj mouse <10|20|40|60|80|100|200 Hz> [1|2|4|8 counts/mm]\n");
+            return;
+        }
+    }
+
+    mouse_config_t config;
+    mouse_get_config(&config);
+    if (!config.present) {
+        terminal_print(term, "No mouse\n");
+        return;
+    }
+    terminal_print(term, config.has_wheel ? "Wheel mouse, " : "Mouse, ");
+    terminal_print_uint(term, config.sample_rate);
+    terminal_print(term, " Hz, ");
+    terminal_print_uint(term, config.resolution);
+    terminal_print(term, " counts/mm, ");
+    terminal_print_uint(term, config.packet_size);
+    terminal_print(term, "-byte packets\n");
+}
+
+/*
+ * aj cpus - list processors and whether they are running
+ */
+static void terminal_cmd_cpus(terminal_t* term) {
+    terminal_print_uint(term, smp_cpu_count());
+    terminal_print(term, " of ");
+    terminal_print_uint(term, smp_cpu_present());
+    terminal_print(term, " CPUs online\n");
+
+    for (int i = 0; i < smp_cpu_present(); i++) {
+        percpu_t* cpu = smp_get_cpu(i);
+        terminal_print(term, "  CPU ");
+        terminal_print_uint(term, cpu->index);
+        terminal_print(term, "  APIC ");
+        terminal_print_uint(term, cpu->apic_id);
+        terminal_print(term, cpu->online ? "  online" : "  offline");
+        terminal_print(term, "  tasks ");
+        terminal_print_uint(term, cpu->tasks_run);
+        terminal_print(term, i == 0 ? " (boot)\n" : "\n");
+    }
+}
+
+/*
+ * aj irqstat - interrupt counts and handler times per IRQ line
+ */
+static void terminal_cmd_irqstat(terminal_t* term) {
+    static const char* buckets[IRQ_HIST_BUCKETS] = {
+        "<1", "<2", "<4", "<8", "<16", "<32", "<64", "64+"
+    };
+    irq_stats_t st;
+
+    terminal_print(term, "IRQ handlers     count  spurious unhandled  avg ns  max ns\n");
+    for (int irq = 0; irq < IRQ_LINES; irq++) {
+        irq_get_stats(irq, &st);
+        if (!st.handlers && !st.count && !st.spurious) continue;
+
+        uint64_t avg = st.count ? div64_32(clock_cycles_to_ns(st.total_cycles), st.count) : 0;
+        terminal_print_field(term, irq, 3);
+        terminal_print_field(term, st.handlers, 9);
+        terminal_print_field(term, st.count, 10);
+        terminal_print_field(term, st.spurious, 10);
+        terminal_print_field(term, st.unhandled, 10);
+        terminal_print_field(term, (uint32_t)avg, 8);
+        terminal_print_field(term, (uint32_t)clock_cycles_to_ns(st.max_cycles), 8);
+        terminal_print(term, "\n");
+    }
+
+    terminal_print(term, "\nHandler time (us):\nIRQ");
+    for (int i = 0; i < IRQ_HIST_BUCKETS; i++) {
+        terminal_print_padded(term, buckets[i], 7, 1);
+    }
+    terminal_print(term, "\n");
+    for (int irq = 0; irq < IRQ_LINES; irq++) {
+        irq_get_stats(irq, &st);
+        if (!st.count) continue;
+
+        terminal_print_field(term, irq, 3);
+        for (int i = 0; i < IRQ_HIST_BUCKETS; i++) {
+            terminal_print_field(term, st.hist[i], 7);
+        }
+        terminal_print(term, "\n");
+    }
+}
+
+/*
+ * aj latency [reset] - input-to-screen latency per stage
+ */
+static void terminal_cmd_latency(terminal_t* term, const char* args) {
+    static const char* buckets[LATENCY_HIST_BUCKETS] = {
+        "<16us", "<32us", "<64us", "<128us", "<256us", "<512us", "<1ms",
+        "<2ms", "<4ms", "<8ms", "<16ms", "<32ms", "32ms+"
+    };
+    latency_stats_t st[LATENCY_STAGES];
+
+    if (strcmp(args, "reset") == 0) {
+        desktop_lock();
+        latency_reset();
+        desktop_unlock();
+        return;
+    }
+    if (*args != '\0') {
+        terminal_print(term, "Usage: aj latency [reset]\n");
+        return;
+    }
+
+    /* The desktop thread updates the statistics with the lock held */
+    desktop_lock();
+    for (int i = 0; i < LATENCY_STAGES; i++) {
+        latency_get_stats(i, &st[i]);
+    }
+    desktop_unlock();
+
+    terminal_print(term, "Stage      count  avg us  max us\n");
+    for (int i = 0; i < LATENCY_STAGES; i++) {
+        const char* name = latency_stage_name(i);
+        uint64_t avg = st[i].count ?
+            div64_32(clock_cycles_to_ns(st[i].total_cycles), st[i].count) : 0;
+        terminal_print(term, name);
+        terminal_print_field(term, st[i].count, 15 - strlen(name));
+        terminal_print_field(term, (uint32_t)div64_32(avg, 1000), 8);
+        terminal_print_field(term,
+            (uint32_t)div64_32(clock_cycles_to_ns(st[i].max_cycles), 1000), 8);
+        terminal_print(term, "\n");
+    }
+
+    terminal_print(term, "\nTime  ");
+    for (int i = 0; i < LATENCY_STAGES; i++) {
+        terminal_print_padded(term, latency_stage_name(i), 8, 1);
+    }
+    terminal_print(term, "\n");
+    for (int b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+        terminal_print_padded(term, buckets[b], 6, 0);
+        for (int i = 0; i < LATENCY_STAGES; i++) {
+            terminal_print_field(term, st[i].hist[b], 8);
+        }
+        terminal_print(term, "\n");
+    }
+}
+
+/*
+ * aj sleep <ms> - block the shell thread; the desktop keeps running
+ */
+static void terminal_cmd_sleep(terminal_t* term, const char* args) {
+    int ms = terminal_parse_uint(&args);
+    if (ms < 0 || *args != '\0') {
+        terminal_print(term, "Usage: aj sleep <milliseconds>\n");
+        return;
+    }
+
+    /* Sleep in slices so Ctrl-C is noticed */
+    uint64_t deadline = timer_uptime_ms() + ms;
+    while (!terminal_check_interrupt(term)) {
+        uint64_t now = timer_uptime_ms();
+        if (now >= deadline) {
+            break;
+        }
+        uint64_t left = deadline - now;
+        timer_sleep_ms(left < TERMINAL_POLL_MS ? (uint32_t)left : TERMINAL_POLL_MS);
+    }
+}
+
 /*
  * Process a command entered in the terminal
  */
 static void terminal_process_command(terminal_t* term) {
     if (!term) return;
 
-    /* Null-terminate the input */
-    term->input_line[term->input_pos] = '\0';
-
     /* Skip leading whitespace */
-    char* cmd = term->input_line;
+    char* cmd = term->command;
     while (*cmd == ' ' || *cmd == '\t') cmd++;
 
     /* Check if empty */
@@ -313,6 +758,14 @@ static void terminal_process_command(terminal_t* term) {
             terminal_print(term, "  aj clear   - Clear terminal\n");
             terminal_print(term, "  aj version - Show version\n");
             terminal_print(term, "  aj echo <text> - Print text\n");
+            terminal_print(term, "  aj blitbench - Benchmark screen copy\n");
+            terminal_print(term, "  aj mode [WxH] - Show or set resolution\n");
+            terminal_print(term, "  aj fps [N] - Show or set frame rate\n");
+            terminal_print(term, "  aj mouse [hz [res]] - Show or set mouse rate\n");
+            terminal_print(term, "  aj cpus    - List processors\n");
+            terminal_print(term, "  aj irqstat - Interrupt counts and handler times\n");
+            terminal_print(term, "  aj latency [reset] - Input to screen latency\n");
+            terminal_print(term, "  aj sleep <ms> - Wait without blocking the desktop\n");
             terminal_print(term, "  aj reboot  - Reboot system\n");
             terminal_print(term, "  aj halt    - Halt CPU\n");
         } else if (strcmp(subcmd, "clear") == 0) {
@@ -324,6 +777,30 @@ static void terminal_process_command(terminal_t* term) {
             terminal_print(term, "\n");
         } else if (strcmp(subcmd, "echo") == 0) {
             terminal_print(term, "\n");
+        } else if (strcmp(subcmd, "blitbench") == 0) {
+            terminal_cmd_blitbench(term);
+        } else if (strcmp(subcmd, "mode") == 0) {
+            terminal_cmd_mode(term, "");
+        } else if (strncmp(subcmd, "mode ", 5) == 0) {
+            terminal_cmd_mode(term, subcmd + 5);
+        } else if (strcmp(subcmd, "fps") == 0) {
+            terminal_cmd_fps(term, "");
+        } else if (strncmp(subcmd, "fps ", 4) == 0) {
+            terminal_cmd_fps(term, subcmd + 4);
+        } else if (strcmp(subcmd, "mouse") == 0) {
+            terminal_cmd_mouse(term, "");
+        } else if (strncmp(subcmd, "mouse ", 6) == 0) {
+            terminal_cmd_mouse(term, subcmd + 6);
+        } else if (strcmp(subcmd, "cpus") == 0) {
+            terminal_cmd_cpus(term);
+        } else if (strcmp(subcmd, "irqstat") == 0) {
+            terminal_cmd_irqstat(term);
+        } else if (strcmp(subcmd, "latency") == 0) {
+            terminal_cmd_latency(term, "");
+        } else if (strncmp(subcmd, "latency ", 8) == 0) {
+            terminal_cmd_latency(term, subcmd + 8);
+        } else if (strncmp(subcmd, "sleep ", 6) == 0) {
+            terminal_cmd_sleep(term, subcmd + 6);
         } else if (strcmp(subcmd, "reboot") == 0) {
             terminal_print(term, "Rebooting...\n");
             /* Send reset command to keyboard controller */
@@ -353,6 +830,35 @@ static void terminal_process_command(terminal_t* term) {
     terminal_show_prompt(term);
 }
 
+/*
+ * Shell thread - runs each entered command, then shows the next prompt
+ */
+static void terminal_shell_main(void* arg) {
+    terminal_t* term = (terminal_t*)arg;
+
+    while (1) {
+        uint32_t flags = cpu_irq_save();
+        while (!term->busy) {
+            thread_wait(&term->command_queue);
+        }
+        cpu_irq_restore(flags);
+
+        terminal_process_command(term);
+
+        /* Keys typed meanwhile go in after the new prompt; a replayed */
+        /* Enter starts the next command and the rest waits for it */
+        desktop_lock();
+        term->busy = 0;
+        while (term->typeahead_count > 0 && !term->busy) {
+            unsigned char key = term->typeahead[term->typeahead_head];
+            term->typeahead_head = (term->typeahead_head + 1) % TERM_TYPEAHEAD;
+            term->typeahead_count--;
+            terminal_handle_key(term, key);
+        }
+        desktop_unlock();
+    }
+}
+
 /*
  * Add a command to history
  */
@@ -409,6 +915,36 @@ static void terminal_set_input(terminal_t* term, const char* str) {
 void terminal_handle_key(terminal_t* term, unsigned char key) {
     if (!term) return;
 
+    /* Typing returns the view to the live screen */
+    if (term->view_offset) {
+        terminal_scroll_view(term, -term->view_offset);
+    }
+
+    if (key == KEY_CTRL('c')) {
+        if (term->busy) {
+            /* Ask the running command to stop; keys typed ahead go too */
+            term->interrupted = 1;
+            term->typeahead_count = 0;
+        } else {
+            /* Discard the line being typed */
+            terminal_print(term, "^C\n");
+            memset(term->input_line, 0, sizeof(term->input_line));
+            term->input_pos = 0;
+            term->browsing_history = 0;
+            terminal_show_prompt(term);
+        }
+        return;
+    }
+    if (term->busy) {
+        /* Hold the key for when the command finishes (dropped if full) */
+        if (term->typeahead_count < TERM_TYPEAHEAD) {
+            int slot = (term->typeahead_head + term->typeahead_count) % TERM_TYPEAHEAD;
+            term->typeahead[slot] = key;
+            term->typeahead_count++;
+        }
+        return;
+    }
+
     if (key == '\n') {
         /* Enter pressed - process command */
         terminal_putchar(term, '\n');
@@ -422,7 +958,17 @@ void terminal_handle_key(terminal_t* term, unsigned char key) {
         term->browsing_history = 0;
         term->history_index = term->history_count;
 
-        terminal_process_command(term);
+        /* Hand the command to the shell thread */
+        term->input_line[term->input_pos] = '\0';
+        memcpy(term->command, term->input_line, sizeof(term->command));
+        term->interrupted = 0;
+        term->busy = 1;
+        if (shell_thread) {
+            thread_wake_one(&term->command_queue);
+        } else {
+            terminal_process_command(term);
+            term->busy = 0;
+        }
 
         /* Clear input buffer */
         memset(term->input_line, 0, sizeof(term->input_line));
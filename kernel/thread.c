@@ -0,0 +1,420 @@
+/*
+ * AJOS Kernel Threads
+ * Round-robin preemptive scheduler on the registers_t interrupt frame
+ */
+
+#include "thread.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "heap.h"
+#include "smp.h"
+#include "string.h"
+#include "timer.h"
+
+#define EFLAGS_RESERVED 0x002
+#define EFLAGS_IF       0x200
+
+static thread_t main_thread;
+static thread_t* idle_thread = 0;
+
+static thread_t* ready_head = 0;
+static thread_t* ready_tail = 0;
+static thread_t* sleepers = 0;      /* Sorted by wake_ms */
+static thread_t* zombie = 0;        /* Exited; freed once off its stack */
+
+static wait_queue_t irq_waiters = WAIT_QUEUE_INIT;
+
+/* Set by thread_wake_interrupt_waiters(), consumed by the next wait */
+static volatile int wake_pending = 0;
+
+static int running = 0;
+static int need_resched = 0;
+static uint64_t slice_end_ms = 0;
+static uint32_t next_id = 1;
+
+/* Clean x87/SSE state for new threads */
+static uint8_t fpu_initial[512] __attribute__((aligned(16)));
+
+/*
+ * Append a thread to a FIFO
+ */
+static void queue_push(thread_t** head, thread_t** tail, thread_t* thread) {
+    thread->next = 0;
+    if (*tail) {
+        (*tail)->next = thread;
+    } else {
+        *head = thread;
+    }
+    *tail = thread;
+}
+
+/*
+ * Remove the first thread of a FIFO
+ */
+static thread_t* queue_pop(thread_t** head, thread_t** tail) {
+    thread_t* thread = *head;
+    if (thread) {
+        *head = thread->next;
+        if (!*head) *tail = 0;
+        thread->next = 0;
+    }
+    return thread;
+}
+
+/*
+ * Make a thread runnable
+ */
+static void make_ready(thread_t* thread) {
+    thread->state = THREAD_READY;
+    queue_push(&ready_head, &ready_tail, thread);
+    need_resched = 1;
+
+    /* Tickless timer: the switch happens on the next interrupt at the latest */
+    timer_wakeup_at(slice_end_ms);
+}
+
+/*
+ * Move sleepers whose time has come to the run queue
+ */
+static void wake_sleepers(uint64_t now) {
+    while (sleepers && sleepers->wake_ms <= now) {
+        thread_t* thread = sleepers;
+        sleepers = thread->next;
+        make_ready(thread);
+    }
+}
+
+/*
+ * Save the outgoing thread and pick the next one
+ * Runs on the outgoing thread's stack with interrupts off.
+ */
+static registers_t* sched_switch(registers_t* regs) {
+    thread_t* prev = thread_current();
+    prev->frame = regs;
+
+    if (prev->state == THREAD_RUNNING) {
+        prev->state = THREAD_READY;
+        if (prev != idle_thread) {
+            queue_push(&ready_head, &ready_tail, prev);
+        }
+    }
+
+    thread_t* next = queue_pop(&ready_head, &ready_tail);
+    if (!next) {
+        next = idle_thread;
+    }
+    next->state = THREAD_RUNNING;
+    need_resched = 0;
+    slice_end_ms = timer_uptime_ms() + THREAD_SLICE_MS;
+
+    /* The previous zombie's stack is no longer in use by anyone */
+    if (zombie) {
+        kfree(zombie->stack);
+        kfree(zombie);
+        zombie = 0;
+    }
+    if (prev->state == THREAD_DEAD) {
+        zombie = prev;
+    }
+
+    if (next != prev) {
+        if (g_cpu.sse_enabled) {
+            __asm__ volatile ("fxsave %0" : "=m"(prev->fpu_state));
+            __asm__ volatile ("fxrstor %0" : : "m"(next->fpu_state));
+        } else {
+            /* x87 only - the 108-byte FSAVE image fits the same area */
+            __asm__ volatile ("fnsave %0" : "=m"(prev->fpu_state));
+            __asm__ volatile ("frstor %0" : : "m"(next->fpu_state));
+        }
+    }
+
+    this_cpu()->current = next;
+    return next->frame;
+}
+
+/*
+ * Idle thread - runs only when nothing else is ready
+ */
+static void idle_main(void* arg) {
+    (void)arg;
+    while (1) {
+        __asm__ volatile ("sti; hlt");
+    }
+}
+
+/*
+ * First code of every new thread (entered through iret)
+ */
+static void thread_start(void) {
+    thread_t* self = thread_current();
+    self->entry(self->arg);
+    thread_exit();
+}
+
+/*
+ * Allocate a thread with a stack whose top holds a frame that "returns"
+ * into thread_start() with interrupts enabled
+ */
+static thread_t* thread_alloc(const char* name, void (*entry)(void*), void* arg) {
+    thread_t* thread = kmalloc(sizeof(thread_t));
+    if (!thread) {
+        return 0;
+    }
+    memset(thread, 0, sizeof(*thread));
+
+    thread->stack = kmalloc(THREAD_STACK_SIZE);
+    if (!thread->stack) {
+        kfree(thread);
+        return 0;
+    }
+
+    /* Same-privilege iret pops eip, cs and eflags only; the useresp slot */
+    /* becomes thread_start()'s (never used) return address */
+    registers_t* frame = (registers_t*)((uint8_t*)thread->stack + THREAD_STACK_SIZE -
+                                        sizeof(registers_t));
+    memset(frame, 0, sizeof(*frame));
+    frame->ds = KERNEL_DATA_SEG;
+    frame->eip = (uint32_t)thread_start;
+    frame->cs = KERNEL_CODE_SEG;
+    frame->eflags = EFLAGS_RESERVED | EFLAGS_IF;
+
+    thread->frame = frame;
+    thread->entry = entry;
+    thread->arg = arg;
+    strncpy(thread->name, name, THREAD_NAME_LEN - 1);
+    memcpy(thread->fpu_state, fpu_initial, sizeof(fpu_initial));
+
+    uint32_t flags = cpu_irq_save();
+    thread->id = next_id++;
+    cpu_irq_restore(flags);
+    return thread;
+}
+
+/*
+ * Start scheduling with the boot context as the main thread
+ */
+void thread_init(void) {
+    if (g_cpu.sse_enabled) {
+        __asm__ volatile ("fxsave %0" : "=m"(fpu_initial));
+    } else {
+        /* fnsave leaves the FPU initialized, like the state it stores */
+        __asm__ volatile ("fninit; fnsave %0" : "=m"(fpu_initial));
+    }
+
+    main_thread.id = 0;
+    strncpy(main_thread.name, "main", THREAD_NAME_LEN - 1);
+    main_thread.state = THREAD_RUNNING;
+    this_cpu()->current = &main_thread;
+
+    idle_thread = thread_alloc("idle", idle_main, 0);
+
+    idt_set_gate(THREAD_YIELD_VECTOR, (uint32_t)thread_yield_stub,
+                 KERNEL_CODE_SEG, IDT_INTERRUPT_GATE);
+    running = idle_thread != 0;
+}
+
+/*
+ * Check whether threads are being scheduled
+ */
+int thread_scheduler_running(void) {
+    return running;
+}
+
+/*
+ * Create a thread and queue it to run
+ */
+thread_t* thread_create(const char* name, void (*entry)(void* arg), void* arg) {
+    thread_t* thread = thread_alloc(name, entry, arg);
+    if (!thread) {
+        return 0;
+    }
+
+    uint32_t flags = cpu_irq_save();
+    make_ready(thread);
+    cpu_irq_restore(flags);
+    return thread;
+}
+
+/*
+ * Get the calling thread
+ */
+thread_t* thread_current(void) {
+    return this_cpu()->current;
+}
+
+/*
+ * Let the next ready thread run
+ */
+void thread_yield(void) {
+    __asm__ volatile ("int %0" : : "i"(THREAD_YIELD_VECTOR) : "memory");
+}
+
+/*
+ * Exit the calling thread; its memory is freed after the next switch
+ */
+void thread_exit(void) {
+    __asm__ volatile ("cli");
+    thread_current()->state = THREAD_DEAD;
+    thread_yield();
+    while (1);  /* Not reached */
+}
+
+/*
+ * Sleep for at least ms milliseconds
+ */
+void thread_sleep_ms(uint32_t ms) {
+    uint32_t flags = cpu_irq_save();
+    thread_t* self = thread_current();
+
+    self->wake_ms = timer_uptime_ms() + ms;
+    self->state = THREAD_SLEEPING;
+
+    /* Keep the list sorted so only its head needs checking */
+    thread_t** link = &sleepers;
+    while (*link && (*link)->wake_ms <= self->wake_ms) {
+        link = &(*link)->next;
+    }
+    self->next = *link;
+    *link = self;
+
+    timer_wakeup_at(self->wake_ms);
+    thread_yield();
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Block until the next hardware interrupt
+ */
+void thread_wait_interrupt(void) {
+    /* A wakeup sent before we got here is not lost */
+    if (wake_pending) {
+        wake_pending = 0;
+        return;
+    }
+    if (!running) {
+        __asm__ volatile ("sti; hlt; cli");
+        return;
+    }
+    thread_wait(&irq_waiters);
+}
+
+/*
+ * Wake threads blocked in thread_wait_interrupt() without an interrupt
+ * Used when another thread hands them work.
+ */
+void thread_wake_interrupt_waiters(void) {
+    uint32_t flags = cpu_irq_save();
+    wake_pending = 1;
+    thread_wake_all(&irq_waiters);
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Block on a wait queue (interrupts must be off)
+ */
+void thread_wait(wait_queue_t* queue) {
+    thread_t* self = thread_current();
+    self->state = THREAD_BLOCKED;
+    queue_push(&queue->head, &queue->tail, self);
+    thread_yield();
+}
+
+/*
+ * Wake the longest-waiting thread on a queue
+ */
+void thread_wake_one(wait_queue_t* queue) {
+    uint32_t flags = cpu_irq_save();
+    thread_t* thread = queue_pop(&queue->head, &queue->tail);
+    if (thread) {
+        make_ready(thread);
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Wake every thread on a queue
+ */
+void thread_wake_all(wait_queue_t* queue) {
+    uint32_t flags = cpu_irq_save();
+    thread_t* thread;
+    while ((thread = queue_pop(&queue->head, &queue->tail)) != 0) {
+        make_ready(thread);
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Take a mutex, sleeping while another thread holds it
+ */
+void mutex_lock(mutex_t* mutex) {
+    uint32_t flags = cpu_irq_save();
+    thread_t* self = thread_current();
+
+    if (mutex->owner == self) {
+        mutex->depth++;
+    } else {
+        while (mutex->owner) {
+            thread_wait(&mutex->waiters);
+        }
+        mutex->owner = self;
+        mutex->depth = 1;
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Release a mutex (once per mutex_lock)
+ */
+void mutex_unlock(mutex_t* mutex) {
+    uint32_t flags = cpu_irq_save();
+    if (--mutex->depth == 0) {
+        mutex->owner = 0;
+        thread_wake_one(&mutex->waiters);
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Scheduler work at the end of every hardware interrupt
+ * Wakes interrupt waiters and due sleepers, and switches threads if one
+ * was woken or the running thread's slice is over.
+ */
+registers_t* thread_irq_exit(registers_t* regs) {
+    if (!running || this_cpu()->index != 0) {
+        return regs;
+    }
+
+    uint64_t now = timer_uptime_ms();
+
+    while (irq_waiters.head) {
+        make_ready(queue_pop(&irq_waiters.head, &irq_waiters.tail));
+    }
+    wake_sleepers(now);
+
+    if (ready_head && now >= slice_end_ms) {
+        need_resched = 1;
+    }
+
+    /* Tickless timer: make sure we get back for the slice end or a sleeper */
+    if (ready_head) {
+        timer_wakeup_at(slice_end_ms);
+    }
+    if (sleepers) {
+        timer_wakeup_at(sleepers->wake_ms);
+    }
+
+    if (!need_resched || !ready_head) {
+        need_resched = 0;
+        return regs;
+    }
+    return sched_switch(regs);
+}
+
+/*
+ * Voluntary switch (THREAD_YIELD_VECTOR)
+ * The caller already set its state: still running (yield), blocked,
+ * sleeping or dead.
+ */
+registers_t* thread_yield_handler(registers_t* regs) {
+    return sched_switch(regs);
+}
@@ -0,0 +1,263 @@
+/*
+ * AJOS Timer Driver
+ * Periodic PIT tick on IRQ0, or tickless local APIC one-shot deadlines
+ */
+
+#include "timer.h"
+#include "io.h"
+#include "irq.h"
+#include "cpu.h"
+#include "apic.h"
+#include "clock.h"
+#include "thread.h"
+
+/* Channel 0, lobyte/hibyte access, mode 2 (rate generator), binary */
+#define PIT_CMD_CHANNEL0_RATE 0x34
+
+/* Channel 2, lobyte/hibyte access, mode 0 (interrupt on terminal count) */
+#define PIT_CMD_CHANNEL2_ONESHOT 0xB0
+
+static uint32_t timer_hz = 0;
+
+/* Advanced only by timer_handler() */
+static volatile uint64_t ticks = 0;
+static volatile uint64_t uptime_ms = 0;
+static uint32_t ms_remainder = 0;   /* Fractions of a millisecond, in 1/hz */
+
+/* Local APIC timer LVT modes */
+#define LAPIC_TIMER_ONESHOT      0x00000
+#define LAPIC_TIMER_TSC_DEADLINE 0x40000
+#define LAPIC_TIMER_DIV16        0x3
+#define MSR_TSC_DEADLINE         0x6E0
+#define LAPIC_CALIBRATE_MS       10
+
+/* Tickless mode - the PIT is masked and the APIC timer fires on demand */
+static int tickless = 0;
+static int tsc_deadline = 0;             /* TSC-deadline instead of one-shot count */
+static uint32_t lapic_ticks_per_ms = 0;
+static uint64_t uptime_offset_ms = 0;    /* Tick uptime when we switched over */
+static uint64_t next_wakeup_ms = TIMER_NO_DEADLINE;
+
+/*
+ * Read a 64-bit counter without the interrupt handler tearing it
+ */
+static uint64_t read_counter(volatile uint64_t* counter) {
+    uint32_t flags = cpu_irq_save();
+    uint64_t value = *counter;
+    cpu_irq_restore(flags);
+    return value;
+}
+
+/*
+ * Timer interrupt handler (IRQ0)
+ * Milliseconds are accumulated exactly, so rates that do not divide
+ * 1000 evenly still keep uptime on time. In tickless mode the local APIC
+ * timer arrives on the same vector.
+ */
+static int timer_handler(void* ctx) {
+    (void)ctx;
+    ticks++;
+
+    /* Tickless: a deadline passed; whoever asked re-arms if still waiting */
+    if (tickless) {
+        next_wakeup_ms = TIMER_NO_DEADLINE;
+        return IRQ_HANDLED;
+    }
+
+    ms_remainder += 1000;
+    while (ms_remainder >= timer_hz) {
+        ms_remainder -= timer_hz;
+        uptime_ms++;
+    }
+    return IRQ_HANDLED;
+}
+
+/*
+ * Start the system tick
+ * hz is clamped to [TIMER_MIN_HZ, TIMER_MAX_HZ]
+ */
+void timer_init(uint32_t hz) {
+    if (hz < TIMER_MIN_HZ) hz = TIMER_MIN_HZ;
+    if (hz > TIMER_MAX_HZ) hz = TIMER_MAX_HZ;
+
+    uint32_t divisor = (PIT_BASE_HZ + hz / 2) / hz;
+    timer_hz = (PIT_BASE_HZ + divisor / 2) / divisor;
+
+    uint32_t flags = cpu_irq_save();
+    outb(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0_RATE);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+
+    ticks = 0;
+    uptime_ms = 0;
+    ms_remainder = 0;
+    cpu_irq_restore(flags);
+
+    irq_register(0, timer_handler, 0);
+    irq_unmask(0);
+}
+
+/*
+ * Get the tick rate in Hz
+ */
+uint32_t timer_get_frequency(void) {
+    return timer_hz;
+}
+
+/*
+ * Get ticks since timer_init()
+ */
+uint64_t timer_get_ticks(void) {
+    return read_counter(&ticks);
+}
+
+/*
+ * Get milliseconds since timer_init()
+ * In tickless mode this comes from the TSC clock, so it also advances
+ * with interrupts off.
+ */
+uint64_t timer_uptime_ms(void) {
+    if (tickless) {
+        return clock_now_ms() + uptime_offset_ms;
+    }
+    return read_counter(&uptime_ms);
+}
+
+/*
+ * Sleep for at least ms milliseconds
+ * Once threads run, only the caller blocks. Before that the CPU halts
+ * until the deadline; other interrupts are serviced meanwhile.
+ */
+void timer_sleep_ms(uint32_t ms) {
+    if (thread_scheduler_running()) {
+        thread_sleep_ms(ms);
+        return;
+    }
+
+    uint64_t deadline = timer_uptime_ms() + ms;
+
+    while (timer_uptime_ms() < deadline) {
+        timer_wakeup_at(deadline);
+        __asm__ volatile ("sti; hlt");
+    }
+}
+
+/*
+ * Measure the local APIC timer rate against the TSC
+ */
+static void lapic_timer_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+
+    uint64_t end = cpu_rdtsc() + (uint64_t)clock_get_tsc_khz() * LAPIC_CALIBRATE_MS;
+    while (cpu_rdtsc() < end);
+
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+    lapic_ticks_per_ms = elapsed / LAPIC_CALIBRATE_MS;
+}
+
+/*
+ * Program the APIC timer to fire at uptime ms
+ */
+static void lapic_timer_program(uint64_t ms) {
+    if (tsc_deadline) {
+        uint64_t clock_ms = ms > uptime_offset_ms ? ms - uptime_offset_ms : 0;
+        cpu_wrmsr(MSR_TSC_DEADLINE, clock_ms_to_tsc(clock_ms));
+        return;
+    }
+
+    uint64_t now = timer_uptime_ms();
+    uint64_t count = ms > now ? (ms - now) * lapic_ticks_per_ms : 1;
+    if (count == 0) count = 1;
+    if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;    /* Fires early; caller re-arms */
+    lapic_write(LAPIC_TIMER_INITIAL, (uint32_t)count);
+}
+
+/*
+ * Switch from the periodic PIT tick to tickless deadlines
+ * Needs the local APIC and a calibrated TSC. The APIC timer uses the
+ * PIT's vector, so timer_handler() keeps receiving it.
+ * Returns 0 on success, -1 if the periodic tick stays in use
+ */
+int timer_enable_tickless(void) {
+    if (!apic_is_enabled() || clock_get_tsc_khz() == 0) {
+        return -1;
+    }
+
+    uint32_t flags = cpu_irq_save();
+
+    tsc_deadline = (g_cpu.features_ecx & CPUID_ECX_TSC_DEADLINE) != 0;
+    if (tsc_deadline) {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | APIC_IRQ_BASE_VECTOR);
+    } else {
+        lapic_timer_calibrate();
+        if (lapic_ticks_per_ms == 0) {
+            cpu_irq_restore(flags);
+            return -1;
+        }
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_ONESHOT | APIC_IRQ_BASE_VECTOR);
+    }
+
+    /* Carry on from the tick count so uptime never goes backwards */
+    uint64_t now = clock_now_ms();
+    uptime_offset_ms = uptime_ms > now ? uptime_ms - now : 0;
+
+    irq_mask(0);
+    next_wakeup_ms = TIMER_NO_DEADLINE;
+    tickless = 1;
+
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+/*
+ * Check whether the timer runs tickless
+ */
+int timer_is_tickless(void) {
+    return tickless;
+}
+
+/*
+ * Make sure the CPU wakes up by uptime ms
+ * Only the earliest outstanding request is kept; it is dropped once it
+ * fires, so callers that are still waiting ask again before halting.
+ * With the periodic tick this is a no-op - the next tick wakes us anyway.
+ */
+void timer_wakeup_at(uint64_t ms) {
+    if (!tickless) {
+        return;
+    }
+
+    uint32_t flags = cpu_irq_save();
+    if (ms < next_wakeup_ms) {
+        next_wakeup_ms = ms;
+        lapic_timer_program(ms);
+    }
+    cpu_irq_restore(flags);
+}
+
+/*
+ * Start a one-shot countdown of ms milliseconds on PIT channel 2
+ * The speaker stays off - we only watch the gate output bit. Used for
+ * calibration, where interrupts may be off and the tick is too coarse.
+ */
+void timer_oneshot_start(uint32_t ms) {
+    uint32_t count = PIT_BASE_HZ * ms / 1000;
+    if (count > 0xFFFF) count = 0xFFFF;
+
+    /* Gate high, speaker data off */
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+
+    outb(PIT_COMMAND_PORT, PIT_CMD_CHANNEL2_ONESHOT);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+}
+
+/*
+ * Check whether the channel 2 countdown has reached zero
+ */
+int timer_oneshot_expired(void) {
+    return (inb(PIT_GATE_PORT) & 0x20) != 0;
+}
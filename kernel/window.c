@@ -2,6 +2,8 @@
 #include "graphics.h"
 #include "font.h"
 #include "string.h"
+#include "heap.h"
+#include "taskpool.h"
 
 // Colors for window decorations
 #define COLOR_TITLEBAR_FOCUSED   RGB(0, 0, 128)    // Dark blue (#000080)
@@ -10,6 +12,10 @@
 #define COLOR_WINDOW_BG          RGB(192, 192, 192) // Light gray (#C0C0C0)
 #define COLOR_WINDOW_BORDER      COLOR_DARK_GRAY
 
+// Compositing tiles (doubled on screens with more than WM_MAX_TILES)
+#define WM_TILE_SIZE 64
+#define WM_MAX_TILES 1024
+
 // Close button dimensions
 #define CLOSE_BTN_SIZE 16
 #define CLOSE_BTN_MARGIN 4
@@ -18,10 +24,22 @@
 static window_t windows[MAX_WINDOWS];
 static int window_count = 0;
 
-// Z-order array (indices into windows array, front to back)
+// Z-order array (indices into windows array, back to front)
 static int z_order[MAX_WINDOWS];
 static int z_count = 0;
 
+// Screen area that must be recomposited this frame
+static region_t damage;
+
+// Per-window visible region (window rect minus windows in front of it)
+static region_t visible[MAX_WINDOWS];
+
+// Union of all window rects
+static region_t covered;
+
+// Damage of the previous frame, repainted again when page flipping
+static region_t last_damage;
+
 // Initialize window manager
 void wm_init(void) {
     window_count = 0;
@@ -33,7 +51,17 @@ void wm_init(void) {
         windows[i].focused = 0;
         windows[i].draw_content = 0;
         windows[i].on_key = 0;
+        windows[i].on_wheel = 0;
+        windows[i].surface.pixels = 0;
+        windows[i].dirty = 1;
+        windows[i].drawn = 0;
+        region_clear(&visible[i]);
     }
+
+    // First frame composites the whole screen
+    region_clear(&damage);
+    region_clear(&last_damage);
+    wm_damage(0, 0, graphics_get_width(), graphics_get_height());
 }
 
 // Find an empty window slot
@@ -64,6 +92,11 @@ window_t* wm_create_window(int x, int y, int width, int height, const char* titl
     win->bg_color = COLOR_WINDOW_BG;
     win->draw_content = 0;
     win->on_key = 0;
+    win->on_wheel = 0;
+    win->surface.pixels = 0;
+    win->surface.width = 0;
+    win->surface.height = 0;
+    win->dirty = 1;
 
     // Copy title
     int i = 0;
@@ -115,9 +148,11 @@ void wm_destroy_window(window_t* win) {
         z_count--;
     }
 
-    // Clear window
+    // Clear window and release its backing store
     win->visible = 0;
     win->focused = 0;
+    kfree(win->surface.pixels);
+    win->surface.pixels = 0;
 
     // Focus top window if any
     if (z_count > 0) {
@@ -140,13 +175,17 @@ void wm_focus_window(window_t* win) {
 
     if (win_idx < 0) return;
 
-    // Unfocus all windows
+    // Unfocus all windows (titlebar color changes, so re-render)
     for (int i = 0; i < MAX_WINDOWS; i++) {
-        windows[i].focused = 0;
+        if (windows[i].focused) {
+            windows[i].focused = 0;
+            windows[i].dirty = 1;
+        }
     }
 
     // Focus this window
     win->focused = 1;
+    win->dirty = 1;
 
     // Move to front of z-order
     int z_idx = -1;
@@ -264,15 +303,312 @@ void wm_draw_window(window_t* win) {
     }
 }
 
-// Draw all visible windows (back to front)
-void wm_draw_all(void) {
-    // Draw in z-order (back to front)
+// Mark a window's contents as changed
+void wm_invalidate(window_t* win) {
+    if (win) {
+        win->dirty = 1;
+    }
+}
+
+// Make sure the window's surface matches its size
+// Returns 0 if no backing store could be allocated
+static int wm_ensure_surface(window_t* win) {
+    if (win->surface.pixels &&
+        win->surface.width == win->width &&
+        win->surface.height == win->height) {
+        return 1;
+    }
+
+    kfree(win->surface.pixels);
+    win->surface.pixels = kmalloc((size_t)win->width * win->height * 4);
+    if (!win->surface.pixels) {
+        win->surface.width = 0;
+        win->surface.height = 0;
+        return 0;
+    }
+
+    win->surface.width = win->width;
+    win->surface.height = win->height;
+    win->surface.pitch = win->width * 4;
+    win->dirty = 1;
+    return 1;
+}
+
+// Re-render a window into its backing store if its contents changed
+// Returns 0 if the window has no backing store
+static int wm_render_window(window_t* win) {
+    if (!wm_ensure_surface(win)) {
+        return 0;
+    }
+
+    if (win->dirty) {
+        draw_set_target(&win->surface, win->x, win->y);
+        wm_draw_window(win);
+        draw_reset_target();
+        win->dirty = 0;
+    }
+    return 1;
+}
+
+// The screen changed size - pull windows back inside
+// width x height is the area windows may occupy; everything is recomposited.
+void wm_screen_resized(int width, int height) {
+    for (int i = 0; i < MAX_WINDOWS; i++) {
+        window_t* win = &windows[i];
+        if (!win->visible) continue;
+
+        if (win->width > width) win->width = width;
+        if (win->height > height) win->height = height;
+        if (win->x + win->width > width) win->x = width - win->width;
+        if (win->y + win->height > height) win->y = height - win->height;
+        win->dirty = 1;
+    }
+
+    // Last frame's damage may lie outside the new screen - repaint it all
+    region_clear(&damage);
+    region_clear(&last_damage);
+    wm_damage(0, 0, graphics_get_width(), graphics_get_height());
+}
+
+// Check whether the next frame would composite anything
+// True when there is pending damage, a window opened, closed, moved or
+// resized, or a window that can be seen has new contents.
+int wm_needs_redraw(void) {
+    if (!region_is_empty(&damage)) return 1;
+
+    for (int i = 0; i < MAX_WINDOWS; i++) {
+        window_t* win = &windows[i];
+        if (win->visible != win->drawn) return 1;
+        if (!win->visible) continue;
+
+        if (win->x != win->drawn_x || win->y != win->drawn_y ||
+            win->width != win->drawn_width || win->height != win->drawn_height) {
+            return 1;
+        }
+        // Contents of a fully covered window can wait until it is exposed
+        if (win->dirty && !region_is_empty(&visible[i])) return 1;
+    }
+    return 0;
+}
+
+// Mark a screen area for recompositing
+void wm_damage(int x, int y, int width, int height) {
+    rect_t r = rect_make(x, y, width, height);
+    region_union_rect(&damage, &r);
+}
+
+// Work out what must be recomposited this frame
+// Computes every window's visible region, adds damage for moved, resized,
+// closed and re-rendered windows, and returns in exposed the damaged area
+// not covered by any window (the caller paints the desktop there).
+// Call once per frame before wm_draw_all().
+void wm_collect_damage(region_t* exposed) {
+    rect_t screen = rect_make(0, 0, graphics_get_width(), graphics_get_height());
+
+    // Geometry changes damage both the old and the new area
+    for (int i = 0; i < MAX_WINDOWS; i++) {
+        window_t* win = &windows[i];
+        int moved = win->drawn &&
+                    (!win->visible ||
+                     win->x != win->drawn_x || win->y != win->drawn_y ||
+                     win->width != win->drawn_width || win->height != win->drawn_height);
+
+        if (moved) {
+            wm_damage(win->drawn_x, win->drawn_y, win->drawn_width, win->drawn_height);
+        }
+        if (win->visible && (moved || !win->drawn)) {
+            wm_damage(win->x, win->y, win->width, win->height);
+        }
+
+        win->drawn = win->visible;
+        win->drawn_x = win->x;
+        win->drawn_y = win->y;
+        win->drawn_width = win->width;
+        win->drawn_height = win->height;
+    }
+
+    // Visible regions, front to back
+    region_clear(&covered);
+    for (int i = z_count - 1; i >= 0; i--) {
+        int slot = z_order[i];
+        window_t* win = &windows[slot];
+        region_t* vis = &visible[slot];
+
+        region_clear(vis);
+        if (!win->visible) continue;
+
+        rect_t r = rect_make(win->x, win->y, win->width, win->height);
+        region_set_rect(vis, &r);
+        region_intersect_rect(vis, &screen);
+        region_subtract(vis, &covered);
+        // Must not grow past the windows on overflow (see region.h)
+        region_union_rect_inner(&covered, &r);
+
+        // Changed contents only matter where the window can be seen
+        if (win->dirty) {
+            region_union(&damage, vis);
+        }
+    }
+
+    region_intersect_rect(&damage, &screen);
+
+    // A flipped back page is one frame behind - it also misses last frame's damage
+    if (graphics_buffer_age() > 1) {
+        static region_t own;
+        region_copy(&own, &damage);
+        region_union(&damage, &last_damage);
+        region_copy(&last_damage, &own);
+        region_intersect_rect(&damage, &screen);
+    }
+
+    // Desktop background shows through the damage no window covers
+    region_copy(exposed, &damage);
+    region_subtract(exposed, &covered);
+}
+
+// Tile compositing job: what every tile task reads (never writes)
+typedef struct {
+    const region_t* background;     // 0 after the first pass
+    color_t bg_color;
+    int tile_size;
+    int columns;
+    uint16_t tiles[WM_MAX_TILES];   // Damaged tiles, row-major index
+    int paint[MAX_WINDOWS];         // Windows to blit, back to front
+    int paint_count;
+} tile_job_t;
+
+// Composite one tile: desktop background, then windows back to front
+// Every write stays inside the tile, so tiles can run on any CPU at once.
+static void wm_composite_tile(void* arg, int index) {
+    const tile_job_t* job = arg;
+    int tile = job->tiles[index];
+    rect_t bounds = rect_make((tile % job->columns) * job->tile_size,
+                              (tile / job->columns) * job->tile_size,
+                              job->tile_size, job->tile_size);
+    rect_t r;
+
+    for (int i = 0; job->background && i < job->background->count; i++) {
+        if (rect_intersect(&job->background->rects[i], &bounds, &r)) {
+            draw_screen_fill(r.x1, r.y1, r.x2 - r.x1, r.y2 - r.y1, job->bg_color);
+        }
+    }
+
+    for (int i = 0; i < job->paint_count; i++) {
+        int slot = job->paint[i];
+        window_t* win = &windows[slot];
+        const region_t* vis = &visible[slot];
+
+        for (int j = 0; j < vis->count; j++) {
+            rect_t piece;
+            if (!rect_intersect(&vis->rects[j], &bounds, &piece)) continue;
+
+            // Visible pieces are not clipped to the damage yet
+            for (int k = 0; k < damage.count; k++) {
+                if (rect_intersect(&piece, &damage.rects[k], &r)) {
+                    draw_screen_blit(r.x1, r.y1, &win->surface,
+                                     r.x1 - win->x, r.y1 - win->y,
+                                     r.x2 - r.x1, r.y2 - r.y1);
+                }
+            }
+        }
+    }
+}
+
+// Composite the damaged screen area: desktop background and visible windows
+// Dirty window surfaces are re-rendered first (serially - rendering uses the
+// shared draw target), then the damage is split into tiles that the task
+// pool composites on every CPU. Fully hidden windows are skipped without
+// re-rendering.
+void wm_draw_all(const region_t* background, color_t bg_color) {
+    static region_t clip;
+    static tile_job_t job;
+    static uint8_t tile_marked[WM_MAX_TILES];
+    int paint[MAX_WINDOWS];         // Back to front
+    int fallback[MAX_WINDOWS];      // Per paint entry: no surface, draw directly
+    int paint_count = 0;
+
     for (int i = 0; i < z_count; i++) {
-        window_t* win = &windows[z_order[i]];
-        if (win->visible) {
-            wm_draw_window(win);
+        int slot = z_order[i];
+        window_t* win = &windows[slot];
+        if (!win->visible || region_is_empty(&visible[slot])) continue;
+
+        region_copy(&clip, &visible[slot]);
+        region_intersect(&clip, &damage);
+        if (region_is_empty(&clip)) continue;
+
+        paint[paint_count] = slot;
+        fallback[paint_count] = !wm_render_window(win);
+        paint_count++;
+    }
+
+    // Double the tile size until the grid fits the tile list
+    int screen_w = graphics_get_width();
+    int screen_h = graphics_get_height();
+    rect_t screen = rect_make(0, 0, screen_w, screen_h);
+    job.tile_size = WM_TILE_SIZE;
+    while (((screen_w + job.tile_size - 1) / job.tile_size) *
+           ((screen_h + job.tile_size - 1) / job.tile_size) > WM_MAX_TILES) {
+        job.tile_size *= 2;
+    }
+    job.columns = (screen_w + job.tile_size - 1) / job.tile_size;
+    int rows = (screen_h + job.tile_size - 1) / job.tile_size;
+
+    // Tiles touched by the damage, each listed once
+    memset(tile_marked, 0, job.columns * rows);
+    int tile_count = 0;
+    for (int i = 0; i < damage.count; i++) {
+        rect_t r;
+        if (!rect_intersect(&damage.rects[i], &screen, &r)) continue;
+        for (int ty = r.y1 / job.tile_size; ty <= (r.y2 - 1) / job.tile_size; ty++) {
+            for (int tx = r.x1 / job.tile_size; tx <= (r.x2 - 1) / job.tile_size; tx++) {
+                int tile = ty * job.columns + tx;
+                if (!tile_marked[tile]) {
+                    tile_marked[tile] = 1;
+                    job.tiles[tile_count++] = tile;
+                }
+            }
+        }
+    }
+
+    // Tile passes over runs of windows with surfaces. A window without one
+    // (out of memory) is drawn straight to the screen between the passes,
+    // so everything keeps its stacking order even where visible regions
+    // overlap (they may, after a region overflow).
+    job.background = background;
+    job.bg_color = bg_color;
+    int next = 0;
+    while (next < paint_count || job.background) {
+        job.paint_count = 0;
+        while (next < paint_count && !fallback[next]) {
+            job.paint[job.paint_count++] = paint[next++];
+        }
+        if (job.paint_count || job.background) {
+            taskpool_run(wm_composite_tile, &job, tile_count);
+        }
+        job.background = 0;
+
+        if (next < paint_count) {
+            window_t* win = &windows[paint[next]];
+
+            region_copy(&clip, &visible[paint[next]]);
+            region_intersect(&clip, &damage);
+            for (int j = 0; j < clip.count; j++) {
+                rect_t* r = &clip.rects[j];
+                draw_set_clip(r->x1, r->y1, r->x2 - r->x1, r->y2 - r->y1);
+                wm_draw_window(win);
+            }
+            draw_reset_clip();
+            win->dirty = 0;
+            next++;
         }
     }
+
+    for (int i = 0; i < damage.count; i++) {
+        rect_t* r = &damage.rects[i];
+        graphics_mark_dirty(r->x1, r->y1, r->x2 - r->x1, r->y2 - r->y1);
+    }
+
+    region_clear(&damage);
 }
 
 // Check if point is inside close button
@@ -334,9 +670,22 @@ void wm_handle_mouse(int x, int y, int buttons) {
 }
 
 // Handle keyboard input
-void wm_handle_key(unsigned char key) {
+void wm_handle_key(unsigned char key, uint8_t modifiers) {
     window_t* focused = wm_get_focused();
     if (focused && focused->on_key) {
-        focused->on_key(focused, key);
+        focused->on_key(focused, key, modifiers);
+    }
+}
+
+// Handle the mouse wheel - goes to the window under the pointer
+void wm_handle_wheel(int x, int y, int delta) {
+    for (int i = z_count - 1; i >= 0; i--) {
+        window_t* win = &windows[z_order[i]];
+        if (!win->visible || !point_in_window(win, x, y)) continue;
+
+        if (win->on_wheel) {
+            win->on_wheel(win, delta);
+        }
+        return;
     }
 }
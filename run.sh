@@ -215,7 +215,7 @@ run_qemu() {
     fi
 
     info "Launching AJOS in QEMU (close QEMU window to exit)..."
-    qemu-system-i386 -cdrom ajos.iso
+    qemu-system-i386 -smp 4 -cdrom ajos.iso
 }
 
 # Clean build artifacts